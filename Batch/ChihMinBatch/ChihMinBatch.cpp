@@ -0,0 +1,253 @@
+//===- ChihMinBatch.cpp - Run the analysis passes over many bitcode files -===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// chihmin-batch loads the pass plugins once and sweeps a list of bitcode
+// files and archives in one process, e.g.
+//
+//   chihmin-batch -load LLVMChihMin.so -load LLVMDataFlow.so -j 8 *.bc
+//
+// Inputs are memory mapped and function bodies are read one at a time.
+// A body without any store, call or loop is freed right after it is read
+// and its declaration is marked readonly, so the call summaries still know
+// it writes nothing. The passes then only walk the functions they can
+// report something on.
+//
+// Every input is analyzed on its own thread with its report buffered, the
+// reports are printed whole, one input at a time.
+//
+//===----------------------------------------------------------------------===//
+
+#include "llvm/Bitcode/ReaderWriter.h"
+#include "llvm/IR/CFG.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/IR/LLVMContext.h"
+#include "llvm/IR/LegacyPassManager.h"
+#include "llvm/IR/Module.h"
+#include "llvm/InitializePasses.h"
+#include "llvm/Object/Archive.h"
+#include "llvm/Pass.h"
+#include "llvm/PassInfo.h"
+#include "llvm/PassRegistry.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/FileSystem.h"
+#include "llvm/Support/ManagedStatic.h"
+#include "llvm/Support/MemoryBuffer.h"
+#include "llvm/Support/PluginLoader.h"
+#include "llvm/Support/PrettyStackTrace.h"
+#include "llvm/Support/Signals.h"
+#include "llvm/Support/raw_ostream.h"
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <vector>
+
+using namespace llvm;
+
+static cl::list<std::string>
+InputFilenames(cl::Positional, cl::OneOrMore,
+               cl::desc("<bitcode files or archives>"));
+
+static cl::list<std::string>
+PassNames("run", cl::CommaSeparated,
+          cl::desc("Passes to run on every input "
+                   "(default: basicaa,tbaa,chihmin,dataflow)"),
+          cl::value_desc("pass,..."));
+
+static cl::opt<unsigned>
+Jobs("j", cl::init(0),
+     cl::desc("Number of inputs analyzed in parallel (0 = one per core)"));
+
+namespace {
+  struct Input {
+    std::string Name;
+    MemoryBufferRef Buffer;
+
+    Input(std::string _Name, MemoryBufferRef _Buffer)
+      : Name(_Name), Buffer(_Buffer) {}
+  };
+
+  std::mutex OutputLock;
+
+  // Report buffer of the input the current thread is analyzing
+  thread_local raw_ostream *ReportStream = NULL;
+}
+
+// The passes look this up when they are loaded and print through it
+extern "C" raw_ostream *chihmin_report_stream() {
+  return ReportStream;
+}
+
+static bool isWorthAnalyzing(Function &F) {
+  std::set<BasicBlock*> visited;
+  for (auto &BB : F) {
+    visited.insert(&BB);
+    for (auto &I : BB) {
+      if (I.mayWriteToMemory() || isa<CallInst>(I) || isa<InvokeInst>(I))
+        return true;
+    }
+    // A branch back to an earlier block closes a loop
+    for (succ_iterator it = succ_begin(&BB); it != succ_end(&BB); ++it) {
+      if (visited.count(*it))
+        return true;
+    }
+  }
+  return false;
+}
+
+static void analyzeInput(const Input &In, ArrayRef<const PassInfo*> Passes) {
+  LLVMContext Context;
+  std::unique_ptr<MemoryBuffer> Buffer =
+    MemoryBuffer::getMemBuffer(In.Buffer, false);
+
+  ErrorOr<std::unique_ptr<Module>> ModuleOrErr =
+    getLazyBitcodeModule(std::move(Buffer), Context);
+  if (std::error_code EC = ModuleOrErr.getError()) {
+    std::lock_guard<std::mutex> Guard(OutputLock);
+    errs() << In.Name << ": " << EC.message() << "\n";
+    return;
+  }
+  std::unique_ptr<Module> M = std::move(*ModuleOrErr);
+
+  for (auto &F : *M) {
+    if (!F.isMaterializable())
+      continue;
+    if (std::error_code EC = F.materialize()) {
+      std::lock_guard<std::mutex> Guard(OutputLock);
+      errs() << In.Name << ": " << F.getName() << ": " << EC.message() << "\n";
+      return;
+    }
+    if (!isWorthAnalyzing(F)) {
+      // callsummary would take a bare declaration as writing anything
+      F.deleteBody();
+      if (!F.doesNotAccessMemory())
+        F.setOnlyReadsMemory();
+    }
+  }
+
+  legacy::PassManager PM;
+  for (auto PI : Passes)
+    PM.add(PI->createPass());
+
+  std::string Report;
+  raw_string_ostream OS(Report);
+  ReportStream = &OS;
+  PM.run(*M);
+  ReportStream = NULL;
+  OS.flush();
+
+  std::lock_guard<std::mutex> Guard(OutputLock);
+  errs() << "==== " << In.Name << " ====\n" << Report;
+}
+
+static bool addInputs(StringRef Filename,
+                      std::vector<std::unique_ptr<MemoryBuffer>> &Buffers,
+                      std::vector<std::unique_ptr<object::Archive>> &Archives,
+                      std::vector<Input> &Inputs) {
+  ErrorOr<std::unique_ptr<MemoryBuffer>> BufferOrErr =
+    MemoryBuffer::getFile(Filename);
+  if (std::error_code EC = BufferOrErr.getError()) {
+    errs() << Filename << ": " << EC.message() << "\n";
+    return false;
+  }
+  Buffers.push_back(std::move(*BufferOrErr));
+  MemoryBufferRef Ref = Buffers.back()->getMemBufferRef();
+
+  if (sys::fs::identify_magic(Ref.getBuffer()) !=
+        sys::fs::file_magic::archive) {
+    Inputs.push_back(Input(Filename, Ref));
+    return true;
+  }
+
+  ErrorOr<std::unique_ptr<object::Archive>> ArchiveOrErr =
+    object::Archive::create(Ref);
+  if (std::error_code EC = ArchiveOrErr.getError()) {
+    errs() << Filename << ": " << EC.message() << "\n";
+    return false;
+  }
+  Archives.push_back(std::move(*ArchiveOrErr));
+
+  for (auto &Child : Archives.back()->children()) {
+    ErrorOr<StringRef> NameOrErr = Child.getName();
+    ErrorOr<MemoryBufferRef> MemberOrErr = Child.getMemoryBufferRef();
+    if (NameOrErr.getError() || MemberOrErr.getError()) {
+      errs() << Filename << ": malformed archive member\n";
+      return false;
+    }
+    if (sys::fs::identify_magic(MemberOrErr->getBuffer()) !=
+          sys::fs::file_magic::bitcode)
+      continue;
+    Inputs.push_back(
+      Input((Filename + "(" + *NameOrErr + ")").str(), *MemberOrErr));
+  }
+  return true;
+}
+
+int main(int argc, char **argv) {
+  sys::PrintStackTraceOnErrorSignal();
+  PrettyStackTraceProgram X(argc, argv);
+  llvm_shutdown_obj Y;
+
+  PassRegistry &Registry = *PassRegistry::getPassRegistry();
+  initializeCore(Registry);
+  initializeAnalysis(Registry);
+  initializeIPA(Registry);
+  initializeTransformUtils(Registry);
+  initializeScalarOpts(Registry);
+
+  cl::ParseCommandLineOptions(argc, argv, "ChihMin batch analysis driver\n");
+
+  if (PassNames.empty()) {
+    PassNames.push_back("basicaa");
+    PassNames.push_back("tbaa");
+    PassNames.push_back("chihmin");
+    PassNames.push_back("dataflow");
+  }
+
+  std::vector<const PassInfo*> Passes;
+  for (auto &Name : PassNames) {
+    const PassInfo *PI = Registry.getPassInfo(Name);
+    if (PI == NULL) {
+      errs() << argv[0] << ": unknown pass '" << Name
+             << "', was its plugin loaded with -load?\n";
+      return 1;
+    }
+    Passes.push_back(PI);
+  }
+
+  std::vector<std::unique_ptr<MemoryBuffer>> Buffers;
+  std::vector<std::unique_ptr<object::Archive>> Archives;
+  std::vector<Input> Inputs;
+  bool Failed = false;
+  for (auto &Filename : InputFilenames)
+    Failed |= !addInputs(Filename, Buffers, Archives, Inputs);
+
+  unsigned NumThreads = Jobs;
+  if (NumThreads == 0)
+    NumThreads = std::max(1u, std::thread::hardware_concurrency());
+  NumThreads = std::min<unsigned>(NumThreads, Inputs.size());
+
+  std::atomic<unsigned> Next(0);
+  auto Worker = [&]() {
+    for (unsigned i = Next++; i < Inputs.size(); i = Next++)
+      analyzeInput(Inputs[i], Passes);
+  };
+
+  std::vector<std::thread> Threads;
+  for (unsigned i = 1; i < NumThreads; ++i)
+    Threads.push_back(std::thread(Worker));
+  Worker();
+  for (auto &T : Threads)
+    T.join();
+
+  return Failed ? 1 : 0;
+}
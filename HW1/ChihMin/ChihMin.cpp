@@ -24,9 +24,19 @@
 #include "llvm/Analysis/LoopInfo.h"
 #include "llvm/PassAnalysisSupport.h"
 #include "llvm/Analysis/LoopPass.h"
+#include "llvm/Analysis/AliasAnalysis.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/IR/Module.h"
+#include "llvm/IR/IRBuilder.h"
+#include "llvm/IR/Intrinsics.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Compiler.h"
+#include <algorithm>
+#include <cstdint>
 #include <vector>
 #include <string>
 #include <map>
+#include <set>
 
 using namespace llvm;
 
@@ -36,54 +46,214 @@ using namespace llvm;
 
 // STATISTIC(Flow_dependence, "Counts number of flow dependece");
 
+STATISTIC(NumCacheHits, "Number of alias queries answered from the cache");
+STATISTIC(NumCacheMisses, "Number of alias queries computed");
+
+static cl::opt<bool> FPReduction("chihmin-fp-reduction",
+    cl::desc("Treat floating point add, mul, min and max as associative "
+             "reductions, like -ffast-math does"));
+
+static cl::opt<bool> ScalarReplacement("chihmin-scalar-repl",
+    cl::desc("Keep values reused across iterations in rotating registers "
+             "instead of reloading them"));
+
+static cl::opt<unsigned> MaxReuseDistance("chihmin-scalar-repl-distance", 
+    cl::init(4), 
+    cl::desc("Largest dependence distance kept in registers"));
+
+static cl::opt<bool> Prefetch("chihmin-prefetch",
+    cl::desc("Insert software prefetches for strided array accesses"));
+
+static cl::opt<unsigned> PrefetchCacheSize("chihmin-prefetch-cache-size", 
+    cl::init(256 * 1024), 
+    cl::desc("Bytes a stream has to span before it is prefetched"));
+
+static cl::opt<unsigned> PrefetchDistance("chihmin-prefetch-distance", 
+    cl::init(16), 
+    cl::desc("Iterations ahead a prefetch is issued"));
+
+static cl::opt<unsigned> IssueWidth("chihmin-issue-width", cl::init(4),
+    cl::desc("Instructions issued per cycle, used for ResMII"));
+
+static cl::opt<unsigned> MemoryPorts("chihmin-memory-ports", cl::init(2),
+    cl::desc("Loads and stores issued per cycle, used for ResMII"));
+
+static cl::opt<bool> ProfileDependence("chihmin-profile",
+    cl::desc("Instrument loops whose subscripts cannot be evaluated "
+             "statically, link with libChihMinProfile.a"));
+
+// Defined by chihmin-batch to buffer the report of the input this thread
+// analyzes, under opt the report goes straight to stderr.
+extern "C" LLVM_ATTRIBUTE_WEAK raw_ostream *chihmin_report_stream();
+
+static raw_ostream &report() {
+  if (chihmin_report_stream != NULL) {
+    if (raw_ostream *OS = chihmin_report_stream())
+      return *OS;
+  }
+  return errs();
+}
+
 namespace {
+  // A subscript written as coef * i + constant, i being the loop's
+  // induction variable.
+  struct AffineIndex {
+    bool valid;
+    int64_t coef, constant;
+    
+    AffineIndex() : valid(false), coef(0), constant(0) {}
+    AffineIndex(int64_t _coef, int64_t _constant) 
+      : valid(true), coef(_coef), constant(_constant) {}
+  };
+  
+  // An array element read or written in the loop. Inst is NULL once a
+  // transform has removed the access.
+  struct AccessStruct {
+    Instruction *Inst, *Array;
+    Value *Base;
+    StringRef Name;
+    int64_t Index;
+    AffineIndex Affine;
+    bool isWrite;
+  };
+  
   // Hello - The first implementation, without getAnalysisUsage.
+  // X[..] = f(..) with every array element f and the subscript of X read.
+  // Elements read only by branches or reductions form statements of
+  // their own, without LHS.
   struct StateStruct {
-    Instruction *LHS, *RHS;
-    StringRef LHS_name, RHS_name;
-
-    int64_t LHSIndex, RHSIndex;
-    
-    StateStruct() {}
-    StateStruct(Instruction *_LHS, Instruction *_RHS, 
-                StringRef _LHS_name, StringRef _RHS_name, 
-                        int64_t _LHSIndex, int64_t _RHSIndex) {
-      LHS = _LHS;
-      RHS = _RHS; 
-      LHS_name = _LHS_name;
-      RHS_name = _RHS_name;
-      LHSIndex = _LHSIndex;
-      RHSIndex = _RHSIndex;
-    }
+    AccessStruct *LHS;
+    std::vector<AccessStruct*> RHS;
+    unsigned position;
+    
+    StateStruct() : LHS(NULL), position(0) {}
+  };
+  
+  // acc = acc op x with the accumulator not touched anywhere else in the
+  // loop. Histograms (H[A[i]] += 1) accumulate into an array element
+  // chosen each iteration and need a private copy of the whole array.
+  struct ReductionStruct {
+    StoreInst *Store;
+    LoadInst *Load;
+    Value *Base;
+    StringRef kind;
+    bool isHistogram;
+  };
+  
+  enum {
+    FLOW_DEPENDENCE = 1,
+    ANTI_DEPENDENCE = 2,
+    OUTPUT_DEPENDENCE = 4
+  };
+  
+  // Edge of the loop's dependence graph: "to" may start latency cycles
+  // after "from" of distance iterations earlier.
+  struct MIIEdge {
+    unsigned from, to;
+    int64_t latency, distance;
+    
+    MIIEdge(unsigned _from, unsigned _to, int64_t _latency, int64_t _distance)
+      : from(_from), to(_to), latency(_latency), distance(_distance) {}
+  };
+  
+  // A load that reads what source (a store, or a load for input
+  // dependences) accessed distance iterations earlier.
+  struct ReuseCandidate {
+    Instruction *source;
+    Value *value;
+    Instruction *sourceArray;
+    AffineIndex sourceIndex;
+    LoadInst *use;
+    int64_t distance;
   };
   
   struct Hello : public LoopPass {
     
-    Hello() : LoopPass(ID) {}
+    Hello() : LoopPass(ID), aliasCacheFunction(NULL) {}
     bool isTargetInst(Instruction *inst); 
     BinaryOperator* getBinaryOp(Value *inst, int step);
     Instruction* getLHSArray(Instruction *inst); 
     Instruction* getRHSArray(Instruction *inst);
     Instruction* getElement(Instruction *inst);
     StringRef getElementName(Instruction *inst);
+    Value* getBase(Instruction *inst);
+    Value* getSpilledArgument(AllocaInst *AI);
+    Value* getSubscript(Instruction *inst);
+    bool isArrayAccess(Instruction *inst);
+    AliasResult getAliasResult(Value *baseA, Value *baseB);
+    AliasResult getAccessAlias(AccessStruct *accessA, AccessStruct *accessB);
     int64_t getIndex(Value *op);
+    AffineIndex getAffine(Loop *loop, Value *op);
+    bool getReachingConstant(Loop *loop, AllocaInst *AI, int64_t &value);
+    void findInductionVariable(Loop *loop);
+    bool collectReads(Value *value, StateStruct *state);
+    StateStruct* getStatement(StoreInst *SI);
+    unsigned testDependence(StateStruct *stateA, StateStruct *stateB);
+    unsigned testSelfDependence(StateStruct *state);
+    bool isSameAddress(Value *ptrA, Value *ptrB);
+    CmpInst* getArmsOfPhi(PHINode *phi, Value *&trueValue, 
+                          Value *&falseValue);
+    StringRef getReductionKind(Instruction *inst, Value *ptr, 
+                               std::vector<LoadInst*> &acc, CmpInst *&cmp);
+    Value* getAccessBase(Value *ptr);
+    ReductionStruct* getReduction(Loop *loop, StoreInst *SI);
     void detectDependence(); 
     void printState(StateStruct *state); 
+    void printReduction(ReductionStruct *reduction); 
     bool isFlowDependence(StateStruct *stateA, StateStruct *stateB);
     bool isAntiDependence(StateStruct *stateA, StateStruct *stateB);
     bool isOutputDependence(StateStruct *stateA, StateStruct *stateB);
     void reportDependence();
+    void clearState();
+    void instrumentLoop(Loop *loop);
+    bool isScalarAccess(Instruction *inst);
+    int64_t getLatency(Instruction *inst);
+    void addMemoryEdge(std::vector<MIIEdge> &edges, 
+                       std::map<Instruction*, unsigned> &nodeId,
+                       Instruction *src, Value *srcBase, AffineIndex srcIndex,
+                       Instruction *dst, Value *dstBase, AffineIndex dstIndex);
+    bool hasPositiveCycle(unsigned numNodes, std::vector<MIIEdge> &edges, 
+                          int64_t II);
+    bool computeMII(Loop *loop);
+    int64_t getTripCount(Loop *loop);
+    bool isOnlyWriter(Loop *loop, Value *base, Instruction *writer);
+    Value* cloneToPreheader(Loop *loop, Instruction *array, int64_t index);
+    bool addReuse(std::vector<ReuseCandidate> &candidates, 
+                  Instruction *source, Value *value, Instruction *sourceArray,
+                  Value *sourceBase, AffineIndex sourceIndex, LoadInst *use,
+                  Value *useBase, AffineIndex useIndex);
+    bool replaceScalars(Loop *loop);
+    bool insertPrefetch(Loop *loop, Instruction *access, Instruction *array, 
+                        AffineIndex index, bool isWrite);
+    bool insertPrefetches(Loop *loop);
     virtual  bool runOnLoop(Loop *, LPPassManager &LPM) ;
+    virtual void getAnalysisUsage(AnalysisUsage &AU) const;
     
     static char ID; // Pass identification, replacement for typeid  
+    AliasAnalysis *AA;
+    // Alias results of base pairs, every loop of a function asks again
+    std::map <std::pair<Value*, Value*>, AliasResult> aliasCache;
+    Function *aliasCacheFunction;
+    const DataLayout *DL;
     std::vector <Instruction*> Inst;
     std::vector <StoreInst*> beginValue;
     std::vector <AllocaInst*> allocArray; 
+    std::vector <AccessStruct*> accessList;
+    std::map <Instruction*, AccessStruct*> accessOf;
     std::vector <StateStruct*> stateList;
+    std::vector <ReductionStruct*> reductionList;
     std::vector <std::pair<StateStruct*, StateStruct*>> flowDependence;
     std::vector <std::pair<StateStruct*, StateStruct*>> outputDependence;
     std::vector <std::pair<StateStruct*, StateStruct*>> antiDependence;
     std::map <AllocaInst*, int64_t> symbolTable; 
+    std::set <AllocaInst*> loopVariant;
+    AllocaInst *inductionVar;
+    ICmpInst *exitCompare;
+    int64_t lowerBound, upperBound, inductionStep;
+    bool hasLowerBound;
+    bool hasUnresolvedIndex;
+    // stores and calls that are not array statements
+    unsigned numSkipped;
   };
 
   bool Hello::runOnLoop(Loop *loop, LPPassManager &LPM ){
@@ -96,6 +266,14 @@ namespace {
 */ 
     auto BB = loop->block_begin() + 1;
     auto entryBlock = (*BB)->getParent()->begin();
+    
+    clearState();
+    AA = &getAnalysis<AliasAnalysis>();
+    DL = &(*BB)->getParent()->getParent()->getDataLayout();
+    if (aliasCacheFunction != (*BB)->getParent()) {
+      aliasCache.clear();
+      aliasCacheFunction = (*BB)->getParent();
+    }
 
     for (auto &I : (*entryBlock)) {
       if (StoreInst *stInst = dyn_cast<StoreInst>(&I)) {
@@ -116,6 +294,7 @@ namespace {
         symbolTable[aInst] = 0;
       }
     }
+    findInductionVariable(loop);
 /* 
     std::map<AllocaInst*, int64_t>::iterator lastElement = --symbolTable.end();
     for (auto par : symbolTable) {
@@ -138,27 +317,115 @@ namespace {
     for (auto &I : Inst) {
       getBinaryOp(dyn_cast<Value>(I), 0);
       DEBUG(errs() << "--------------------------------\n");
-
-      Instruction *LHS = getLHSArray(I);
-      Instruction *RHS = getRHSArray(I);
-      
-      StringRef LHS_name = getElementName(LHS);
-      StringRef RHS_name = getElementName(RHS);
-      
-      Instruction *LHSArray = getElement(LHS); 
-      Instruction *RHSArray = getElement(RHS);
+    }
+    
+    // Every array element the loop itself reads or writes, inner loops
+    // are not analyzed and anything they write is unknown
+    LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+    std::map<Instruction*, unsigned> position;
+    for (auto block = loop->block_begin(); block != loop->block_end(); ++block) {
+      bool isInner = LI.getLoopFor(*block) != loop;
+      for (auto &I : **block) {
+        if (isInner) {
+          if (I.mayWriteToMemory())
+            numSkipped++;
+          continue;
+        }
+        unsigned pos = position.size();
+        position[&I] = pos;
+        
+        Value *ptr = NULL;
+        if (LoadInst *load = dyn_cast<LoadInst>(&I))
+          ptr = load->getPointerOperand();
+        else if (StoreInst *store = dyn_cast<StoreInst>(&I))
+          ptr = store->getPointerOperand();
+        Instruction *array = ptr ? dyn_cast<Instruction>(ptr) : NULL;
+        if (!isArrayAccess(array))
+          continue;
+        
+        AccessStruct *access = new AccessStruct();
+        access->Inst = &I;
+        access->Array = array;
+        access->Base = getBase(array);
+        access->Name = access->Base->getName();
+        access->Index = getIndex(getSubscript(array));
+        access->Affine = getAffine(loop, getSubscript(array));
+        access->isWrite = isa<StoreInst>(I);
+        // getIndex takes spilled parameters and call results as 0
+        if (!access->Affine.valid)
+          hasUnresolvedIndex = true;
+        accessList.push_back(access);
+        accessOf[&I] = access;
+        
+        DEBUG(errs() << *array << " || Index --> " << access->Index << "\n");
+      }
+    }
+    
+    // Every other write is a reduction (also m = x < m ? x : m, stored
+    // where the arms of the ?: join) or an array statement. Scalars
+    // carried across iterations, writes through *p and calls are not
+    // analyzed.
+    for (auto block = loop->block_begin(); block != loop->block_end(); ++block) {
+      if (LI.getLoopFor(*block) != loop)
+        continue;
+      for (auto &I : **block) {
+        if (!I.mayWriteToMemory())
+          continue;
+        StoreInst *SI = dyn_cast<StoreInst>(&I);
+        if (SI != NULL && SI->getPointerOperand() == inductionVar)
+          continue;
+        
+        if (SI != NULL) {
+          if (ReductionStruct *reduction = getReduction(loop, SI)) {
+            reductionList.push_back(reduction);
+            continue;
+          }
+        }
+        
+        StateStruct *state = SI ? getStatement(SI) : NULL;
+        if (state == NULL) {
+          numSkipped++;
+          continue;
+        }
+        state->position = position[SI];
+        stateList.push_back(state);
+      }
+    }
+    
+    // Elements read by branches and reductions, reads through a pointer
+    // that is not an array access cannot be compared with anything
+    std::set<AccessStruct*> claimed;
+    for (auto state : stateList)
+      claimed.insert(state->RHS.begin(), state->RHS.end());
+    for (auto &entry : position) {
+      LoadInst *load = dyn_cast<LoadInst>(entry.first);
+      if (load == NULL || isa<AllocaInst>(load->getPointerOperand()))
+        continue;
       
-      int64_t LHSIndex = getIndex(LHS->getOperand(2));
-      int64_t RHSIndex = getIndex(RHS->getOperand(2));
+      bool isAccumulator = false;
+      for (auto reduction : reductionList) {
+        if (getAliasResult(getAccessBase(load->getPointerOperand()), 
+                           reduction->Base) != NoAlias)
+          isAccumulator = true;
+      }
+      auto access = accessOf.find(load);
+      if (isAccumulator || (access != accessOf.end() && 
+                              claimed.count(access->second)))
+        continue;
+      if (access == accessOf.end()) {
+        numSkipped++;
+        continue;
+      }
       
-      StateStruct *state = 
-          new StateStruct(LHS, RHS, LHS_name, RHS_name, LHSIndex, RHSIndex);
-      stateList.push_back(state); 
-       
-      DEBUG(errs() << *LHSArray << " || " << *RHSArray << "\n");
-      DEBUG(errs() << "Index --> " << LHSIndex << ", " << RHSIndex << "\n");
-      DEBUG(errs() << "===============================\n");
+      StateStruct *state = new StateStruct();
+      state->RHS.push_back(access->second);
+      state->position = entry.second;
+      stateList.push_back(state);
     }
+    std::sort(stateList.begin(), stateList.end(), 
+              [](StateStruct *stateA, StateStruct *stateB) {
+                return stateA->position < stateB->position;
+              });
 /*    
     for (auto &state : stateList) {
       printState(state);
@@ -170,9 +437,468 @@ namespace {
     // getBinaryOp((*(BB+1))->begin(), 0);  
     // getBinaryOp((*(BB-1))->begin(), 0);  
 
+    bool changed = false;
+    if (loop->empty())
+      changed |= computeMII(loop);
+    
+    if (ScalarReplacement)
+      changed |= replaceScalars(loop);
+    
+    if (Prefetch)
+      changed |= insertPrefetches(loop);
+    
+    if (ProfileDependence && hasUnresolvedIndex) {
+      report() << "Subscript is not statically known, loop is instrumented\n";
+      instrumentLoop(loop);
+      return true;
+    }
+    return changed;
+  }
+  
+  void Hello::getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.addRequired<AliasAnalysis>();
+    AU.addRequired<LoopInfoWrapperPass>();
+    if (ProfileDependence || ScalarReplacement || Prefetch)
+      AU.setPreservesCFG();
+    else
+      AU.setPreservesAll();
+  }
+  
+  void Hello::clearState() {
+    for (auto state : stateList)
+      delete state;
+    for (auto reduction : reductionList)
+      delete reduction;
+    for (auto access : accessList)
+      delete access;
+    
+    Inst.clear();
+    beginValue.clear();
+    allocArray.clear();
+    accessList.clear();
+    accessOf.clear();
+    stateList.clear();
+    reductionList.clear();
+    flowDependence.clear();
+    outputDependence.clear();
+    antiDependence.clear();
+    symbolTable.clear();
+    loopVariant.clear();
+    inductionVar = NULL;
+    exitCompare = NULL;
+    lowerBound = upperBound = inductionStep = 0;
+    hasLowerBound = false;
+    hasUnresolvedIndex = false;
+    numSkipped = 0;
+  }
+  
+  // The induction variable is the alloca compared against a constant in
+  // the loop header, e.g. "i < 20". Its initial value is the lower bound,
+  // known only if a constant store reaches the preheader.
+  void Hello::findInductionVariable(Loop *loop) {
+    for (auto block = loop->block_begin(); block != loop->block_end(); ++block) {
+      for (auto &I : **block) {
+        if (StoreInst *SI = dyn_cast<StoreInst>(&I)) {
+          if (AllocaInst *AI = dyn_cast<AllocaInst>(SI->getPointerOperand()))
+            loopVariant.insert(AI);
+        }
+      }
+    }
+    
+    for (auto &I : *loop->getHeader()) {
+      ICmpInst *cmp = dyn_cast<ICmpInst>(&I);
+      if (cmp == NULL)
+        continue;
+      
+      Value *op = cmp->getOperand(0);
+      if (CastInst *cast = dyn_cast<CastInst>(op))
+        op = cast->getOperand(0);
+      LoadInst *LI = dyn_cast<LoadInst>(op);
+      ConstantInt *bound = dyn_cast<ConstantInt>(cmp->getOperand(1));
+      if (LI == NULL || bound == NULL || !isa<AllocaInst>(LI->getOperand(0)))
+        continue;
+      
+      inductionVar = cast<AllocaInst>(LI->getOperand(0));
+      hasLowerBound = getReachingConstant(loop, inductionVar, lowerBound);
+      upperBound = bound->getSExtValue();
+      exitCompare = cmp;
+      break;
+    }
+    if (inductionVar == NULL)
+      return;
+    
+    // The step is known when the only update is "i = i + C" or "i = i - C"
+    for (User *U : inductionVar->users()) {
+      StoreInst *SI = dyn_cast<StoreInst>(U);
+      if (SI == NULL || !loop->contains(SI))
+        continue;
+      if (inductionStep != 0) {
+        inductionStep = 0;
+        return;
+      }
+      
+      BinaryOperator *BI = dyn_cast<BinaryOperator>(SI->getValueOperand());
+      if (BI == NULL)
+        return;
+      LoadInst *LI = dyn_cast<LoadInst>(BI->getOperand(0));
+      ConstantInt *step = dyn_cast<ConstantInt>(BI->getOperand(1));
+      if (LI == NULL || LI->getOperand(0) != inductionVar || step == NULL)
+        return;
+      
+      if (BI->getOpcode() == Instruction::Add)
+        inductionStep = step->getSExtValue();
+      else if (BI->getOpcode() == Instruction::Sub)
+        inductionStep = -step->getSExtValue();
+      else
+        return;
+    }
+  }
+  
+  // Adds the array elements value is computed from to state. False if
+  // it also depends on a scalar written in the loop, a read through a
+  // pointer, a call or a phi.
+  bool Hello::collectReads(Value *value, StateStruct *state) {
+    Instruction *inst = dyn_cast<Instruction>(value);
+    if (inst == NULL || isa<AllocaInst>(inst))
+      return true;
+    
+    if (LoadInst *LI = dyn_cast<LoadInst>(inst)) {
+      if (AllocaInst *AI = dyn_cast<AllocaInst>(LI->getPointerOperand()))
+        return AI == inductionVar || !loopVariant.count(AI);
+      auto access = accessOf.find(LI);
+      if (access == accessOf.end())
+        return false;
+      if (std::find(state->RHS.begin(), state->RHS.end(), access->second) 
+            == state->RHS.end())
+        state->RHS.push_back(access->second);
+      // A[B[i]] reads B[i] as well
+      return collectReads(LI->getPointerOperand(), state);
+    }
+    
+    if (isa<PHINode>(inst) || inst->mayReadOrWriteMemory())
+      return false;
+    for (Value *op : inst->operands()) {
+      if (!collectReads(op, state))
+        return false;
+    }
+    return true;
+  }
+  
+  StateStruct* Hello::getStatement(StoreInst *SI) {
+    auto access = accessOf.find(SI);
+    if (access == accessOf.end())
+      return NULL;
+    
+    StateStruct *state = new StateStruct();
+    state->LHS = access->second;
+    if (!collectReads(SI->getValueOperand(), state) || 
+          !collectReads(state->LHS->Array, state)) {
+      delete state;
+      return NULL;
+    }
+    return state;
+  }
+  
+  // -O0 keeps every scalar in an alloca, a backend keeps them in registers
+  bool Hello::isScalarAccess(Instruction *inst) {
+    if (LoadInst *LI = dyn_cast<LoadInst>(inst))
+      return isa<AllocaInst>(LI->getPointerOperand());
+    if (StoreInst *SI = dyn_cast<StoreInst>(inst))
+      return isa<AllocaInst>(SI->getPointerOperand());
     return false;
   }
   
+  int64_t Hello::getLatency(Instruction *inst) {
+    if (isScalarAccess(inst))
+      return 0;
+    
+    switch (inst->getOpcode()) {
+    case Instruction::Load :
+      return 3;
+    case Instruction::Mul :
+      return 3;
+    case Instruction::SDiv :
+    case Instruction::UDiv :
+    case Instruction::SRem :
+    case Instruction::URem :
+      return 20;
+    case Instruction::FAdd :
+    case Instruction::FSub :
+    case Instruction::FMul :
+      return 4;
+    case Instruction::FDiv :
+    case Instruction::FRem :
+      return 20;
+    case Instruction::Call :
+      return 10;
+    case Instruction::PHI :
+    case Instruction::GetElementPtr :
+    case Instruction::SExt :
+    case Instruction::ZExt :
+    case Instruction::Trunc :
+    case Instruction::BitCast :
+      return 0;
+    }
+    return 1;
+  }
+  
+  // Adds the edge for dst touching the element src touched some
+  // iterations earlier. Subscripts a * i + b and a * i + c meet after
+  // (b - c) / (a * step) iterations, unknown distances are taken as 1.
+  void Hello::addMemoryEdge(std::vector<MIIEdge> &edges, 
+                            std::map<Instruction*, unsigned> &nodeId,
+                            Instruction *src, Value *srcBase, 
+                            AffineIndex srcIndex, Instruction *dst, 
+                            Value *dstBase, AffineIndex dstIndex) {
+    // a NULL base is a call, it may touch anything
+    AliasResult alias = MayAlias;
+    if (srcBase != NULL && dstBase != NULL)
+      alias = getAliasResult(srcBase, dstBase);
+    if (alias == NoAlias)
+      return;
+    
+    unsigned from = nodeId[src], to = nodeId[dst];
+    int64_t latency = getLatency(src);
+    if (alias != MustAlias || !srcIndex.valid || !dstIndex.valid 
+          || inductionStep == 0 || srcIndex.coef != dstIndex.coef) {
+      edges.push_back(MIIEdge(from, to, latency, 1));
+      return;
+    }
+    
+    int64_t diff = srcIndex.constant - dstIndex.constant;
+    if (srcIndex.coef == 0) {
+      if (diff == 0)
+        edges.push_back(MIIEdge(from, to, latency, from < to ? 0 : 1));
+      return;
+    }
+    
+    int64_t stride = srcIndex.coef * inductionStep;
+    if (diff % stride != 0)
+      return;
+    int64_t distance = diff / stride;
+    if (distance > 0 || (distance == 0 && from < to))
+      edges.push_back(MIIEdge(from, to, latency, distance));
+  }
+  
+  // With weights latency - II * distance, II is too small exactly when
+  // some cycle has positive weight.
+  bool Hello::hasPositiveCycle(unsigned numNodes, std::vector<MIIEdge> &edges, 
+                               int64_t II) {
+    const int64_t none = INT64_MIN / 4;
+    std::vector<std::vector<int64_t> > dist(numNodes, 
+        std::vector<int64_t>(numNodes, none));
+    for (auto &edge : edges) {
+      int64_t weight = edge.latency - II * edge.distance;
+      dist[edge.from][edge.to] = std::max(dist[edge.from][edge.to], weight);
+    }
+    
+    for (unsigned k = 0; k < numNodes; ++k) {
+      for (unsigned i = 0; i < numNodes; ++i) {
+        if (dist[i][k] == none)
+          continue;
+        for (unsigned j = 0; j < numNodes; ++j) {
+          if (dist[k][j] == none)
+            continue;
+          dist[i][j] = std::max(dist[i][j], dist[i][k] + dist[k][j]);
+        }
+      }
+      for (unsigned i = 0; i < numNodes; ++i) {
+        if (dist[i][i] > 0)
+          return true;
+      }
+    }
+    return false;
+  }
+  
+  // Builds the dependence graph of an innermost loop: register def-use
+  // edges, -O0 scalar variables going through their alloca, and array
+  // accesses with distances from the subscripts. Reports RecMII and
+  // ResMII and attaches them to the header terminator as !chihmin.mii.
+  bool Hello::computeMII(Loop *loop) {
+    std::vector<Instruction*> nodes;
+    std::map<Instruction*, unsigned> nodeId;
+    for (auto block = loop->block_begin(); block != loop->block_end(); ++block) {
+      for (auto &I : **block) {
+        nodeId[&I] = nodes.size();
+        nodes.push_back(&I);
+      }
+    }
+    
+    std::vector<MIIEdge> edges;
+    int64_t sumLatency = 0;
+    unsigned numOps = 0, numMemOps = 0;
+    for (auto inst : nodes) {
+      sumLatency += getLatency(inst);
+      if (!isa<PHINode>(inst) && !isScalarAccess(inst))
+        numOps++;
+      if ((isa<LoadInst>(inst) || isa<StoreInst>(inst)) && !isScalarAccess(inst))
+        numMemOps++;
+      
+      for (User *U : inst->users()) {
+        Instruction *user = dyn_cast<Instruction>(U);
+        if (user == NULL || !nodeId.count(user))
+          continue;
+        int64_t distance = 0;
+        if (isa<PHINode>(user) && user->getParent() == loop->getHeader())
+          distance = 1;
+        edges.push_back(MIIEdge(nodeId[inst], nodeId[user], 
+                                getLatency(inst), distance));
+      }
+      
+      // store %v, %x -> load %x, in this iteration if the load comes later
+      if (StoreInst *SI = dyn_cast<StoreInst>(inst)) {
+        AllocaInst *AI = dyn_cast<AllocaInst>(SI->getPointerOperand());
+        if (AI == NULL)
+          continue;
+        for (User *U : AI->users()) {
+          LoadInst *LI = dyn_cast<LoadInst>(U);
+          if (LI == NULL || !nodeId.count(LI))
+            continue;
+          unsigned from = nodeId[SI], to = nodeId[LI];
+          edges.push_back(MIIEdge(from, to, getLatency(SI), from < to ? 0 : 1));
+        }
+      }
+    }
+    
+    // Every load and store that is not a scalar, with the base and the
+    // subscript of the dependence analysis where it has them, and every
+    // call that touches memory. Anything without a known subscript is
+    // taken to meet the other access one iteration later.
+    std::vector<AccessStruct> memOps;
+    for (auto inst : nodes) {
+      auto access = accessOf.find(inst);
+      if (access != accessOf.end()) {
+        memOps.push_back(*access->second);
+        continue;
+      }
+      
+      AccessStruct op = AccessStruct();
+      op.Inst = inst;
+      if (LoadInst *LI = dyn_cast<LoadInst>(inst))
+        op.Base = getAccessBase(LI->getPointerOperand());
+      else if (StoreInst *SI = dyn_cast<StoreInst>(inst))
+        op.Base = getAccessBase(SI->getPointerOperand());
+      else if (!isa<CallInst>(inst) || !inst->mayReadOrWriteMemory())
+        continue;
+      if (isScalarAccess(inst))
+        continue;
+      op.isWrite = inst->mayWriteToMemory();
+      memOps.push_back(op);
+    }
+    
+    // flow, anti and output, reads never depend on each other
+    for (auto &src : memOps) {
+      for (auto &dst : memOps) {
+        if (&src == &dst || (!src.isWrite && !dst.isWrite))
+          continue;
+        addMemoryEdge(edges, nodeId, src.Inst, src.Base, src.Affine, 
+                      dst.Inst, dst.Base, dst.Affine);
+      }
+    }
+    
+    // A reduction is a recurrence until it is privatized
+    for (auto reduction : reductionList) {
+      edges.push_back(MIIEdge(nodeId[reduction->Store], nodeId[reduction->Load], 
+                              getLatency(reduction->Store), 1));
+    }
+    
+    int64_t low = 0, high = sumLatency + 1;
+    while (low < high) {
+      int64_t II = (low + high) / 2;
+      if (hasPositiveCycle(nodes.size(), edges, II))
+        low = II + 1;
+      else
+        high = II;
+    }
+    int64_t recMII = low;
+    int64_t resMII = std::max((numOps + IssueWidth - 1) / IssueWidth, 
+                              (numMemOps + MemoryPorts - 1) / MemoryPorts);
+    
+    report() << "RecMII : " << recMII << ", ResMII : " << resMII << "\n";
+    
+    LLVMContext &C = loop->getHeader()->getContext();
+    Type *int32Ty = Type::getInt32Ty(C);
+    Metadata *values[] = {
+      ConstantAsMetadata::get(ConstantInt::get(int32Ty, recMII)),
+      ConstantAsMetadata::get(ConstantInt::get(int32Ty, resMII))
+    };
+    loop->getHeader()->getTerminator()->setMetadata("chihmin.mii", 
+                                                    MDNode::get(C, values));
+    return true;
+  }
+  
+  // Hooks every array access of the loop into the profiling runtime. The
+  // runtime keeps the loop's record in a private slot, so each hook is a
+  // call plus a shadow memory lookup.
+  void Hello::instrumentLoop(Loop *loop) {
+    BasicBlock *preheader = loop->getLoopPreheader();
+    if (preheader == NULL)
+      return;
+    
+    LoopInfo &LI = getAnalysis<LoopInfoWrapperPass>().getLoopInfo();
+    BasicBlock *header = loop->getHeader();
+    Function *F = header->getParent();
+    Module *M = F->getParent();
+    LLVMContext &C = M->getContext();
+    
+    Type *voidTy = Type::getVoidTy(C);
+    Type *int32Ty = Type::getInt32Ty(C);
+    PointerType *int8PtrTy = Type::getInt8PtrTy(C);
+    PointerType *slotTy = PointerType::getUnqual(int8PtrTy);
+    
+    Constant *beginFunc = M->getOrInsertFunction("__chihmin_loop_begin", 
+        voidTy, slotTy, int8PtrTy, int32Ty, NULL);
+    Constant *iterFunc = M->getOrInsertFunction("__chihmin_loop_iter", 
+        voidTy, slotTy, NULL);
+    Constant *accessFunc = M->getOrInsertFunction("__chihmin_access", 
+        voidTy, slotTy, int8PtrTy, int32Ty, int32Ty, NULL);
+    
+    GlobalVariable *slot = new GlobalVariable(*M, int8PtrTy, false, 
+        GlobalValue::PrivateLinkage, ConstantPointerNull::get(int8PtrTy), 
+        "__chihmin_loop");
+    
+    IRBuilder<> builder(preheader->getTerminator());
+    Value *name = builder.CreateGlobalStringPtr(
+        (F->getName() + ":" + header->getName()).str());
+    // A header that tests the exit runs once more than the body
+    Value *headerExits = builder.getInt32(loop->isLoopExiting(header));
+    builder.CreateCall(beginFunc, {slot, name, headerExits});
+    
+    builder.SetInsertPoint(header, header->getFirstInsertionPt());
+    builder.CreateCall(iterFunc, slot);
+    
+    for (auto block = loop->block_begin(); block != loop->block_end(); ++block) {
+      // Accesses of inner loops are profiled with the inner loop
+      if (LI.getLoopFor(*block) != loop)
+        continue;
+      
+      for (auto &I : **block) {
+        Value *ptr;
+        int isWrite;
+        if (LoadInst *load = dyn_cast<LoadInst>(&I)) {
+          ptr = load->getPointerOperand();
+          isWrite = 0;
+        } else if (StoreInst *store = dyn_cast<StoreInst>(&I)) {
+          ptr = store->getPointerOperand();
+          isWrite = 1;
+        } else {
+          continue;
+        }
+        
+        // Scalars such as the induction variable are not array accesses
+        if (!isa<GetElementPtrInst>(ptr))
+          continue;
+        
+        Type *elementTy = cast<PointerType>(ptr->getType())->getElementType();
+        builder.SetInsertPoint(&I);
+        builder.CreateCall(accessFunc, {slot, 
+            builder.CreatePointerCast(ptr, int8PtrTy),
+            builder.getInt32(DL->getTypeStoreSize(elementTy)),
+            builder.getInt32(isWrite)});
+      }
+    }
+  }
+  
   BinaryOperator* Hello::getBinaryOp(Value *inst, int step) {
     int numOperands = 0; 
     if (Instruction *cur_inst = dyn_cast<Instruction>(inst))
@@ -199,14 +925,88 @@ namespace {
 
   Instruction* Hello::getRHSArray(Instruction *inst) {
     Instruction *first = dyn_cast<Instruction>(inst->getOperand(0)); 
+    if (first == NULL || first->getNumOperands() == 0)
+      return NULL;
     return dyn_cast<Instruction>(first->getOperand(0));
   }
   
   StringRef Hello::getElementName(Instruction *inst) {
-    return inst->getOperand(0)->getName();  
+    return getBase(inst)->getName();  
+  }
+  
+  bool Hello::isArrayAccess(Instruction *inst) {
+    return inst != NULL && isa<GetElementPtrInst>(inst);
+  }
+  
+  // Local arrays are indexed as A[0][i], pointers and parameters as p[i],
+  // the subscript is always the last operand.
+  Value* Hello::getSubscript(Instruction *inst) {
+    return inst->getOperand(inst->getNumOperands() - 1);
+  }
+  
+  // Returns the object an array access is based on. Pointer parameters
+  // are spilled to an alloca at -O0 and reloaded before every access, so
+  // the reload is traced back to the incoming argument. That keeps their
+  // noalias attribute visible to the alias analysis.
+  Value* Hello::getBase(Instruction *inst) {
+    Value *ptr = inst->getOperand(0);
+    if (LoadInst *LI = dyn_cast<LoadInst>(ptr)) {
+      if (AllocaInst *AI = dyn_cast<AllocaInst>(LI->getPointerOperand())) {
+        if (Value *arg = getSpilledArgument(AI))
+          return arg;
+      }
+    }
+    return GetUnderlyingObject(ptr, *DL);
+  }
+  
+  Value* Hello::getSpilledArgument(AllocaInst *AI) {
+    Value *arg = NULL;
+    for (User *U : AI->users()) {
+      if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
+        if (SI->getPointerOperand() != AI || arg != NULL)
+          return NULL;
+        arg = SI->getValueOperand();
+      }
+    }
+    if (arg != NULL && isa<Argument>(arg))
+      return arg;
+    return NULL;
+  }
+  
+  AliasResult Hello::getAliasResult(Value *baseA, Value *baseB) {
+    if (baseA == baseB)
+      return MustAlias;
+    // Loads may be erased by the transforms, only objects that live as
+    // long as the function are cached
+    if ((isa<Instruction>(baseA) && !isa<AllocaInst>(baseA)) 
+          || (isa<Instruction>(baseB) && !isa<AllocaInst>(baseB)))
+      return AA->alias(baseA, baseB);
+    if (baseB < baseA)
+      std::swap(baseA, baseB);
+    
+    auto key = std::make_pair(baseA, baseB);
+    auto it = aliasCache.find(key);
+    if (it != aliasCache.end()) {
+      ++NumCacheHits;
+      return it->second;
+    }
+    ++NumCacheMisses;
+    AliasResult result = AA->alias(baseA, baseB);
+    aliasCache[key] = result;
+    return result;
   }
 
 
+  // Subscripts are only compared if both are known, anything else
+  // that may overlap is dependent
+  AliasResult Hello::getAccessAlias(AccessStruct *accessA, 
+                                    AccessStruct *accessB) {
+    AliasResult alias = getAliasResult(accessA->Base, accessB->Base);
+    if (alias == MustAlias && (!accessA->Affine.valid || !accessB->Affine.valid))
+      return MayAlias;
+    return alias;
+  }
+
   Instruction* Hello::getElement(Instruction *inst) {
     return dyn_cast<Instruction>(inst->getOperand(0));
   }
@@ -237,8 +1037,16 @@ namespace {
         break; 
         
       case Instruction::SDiv :
+        if (constB == 0) {
+          hasUnresolvedIndex = true;
+          break;
+        }
         ret = constA / constB;
         break;
+      
+      default :
+        hasUnresolvedIndex = true;
+        break;
       }
 
       return ret;
@@ -248,52 +1056,767 @@ namespace {
     }  
     else if (LoadInst *LI = dyn_cast<LoadInst>(param)){
       AllocaInst *AI = dyn_cast<AllocaInst>(LI->getOperand(0));
+      if (AI == NULL) {
+        // e.g. A[B[i]], the subscript is loaded from memory
+        hasUnresolvedIndex = true;
+        return 0;
+      }
       int64_t prevConst = symbolTable[AI];
       return prevConst;
     } 
     
+    hasUnresolvedIndex = true;
     return 0;  
   }
   
-  bool Hello::isFlowDependence(StateStruct *stateA, StateStruct *stateB) {
-      if (stateA->LHS_name == stateB->RHS_name) {
-        if (stateA->LHSIndex >= stateB->RHSIndex) {
-          return true;    
-        }
+  // Number of times the body runs, -1 if the header compare is not the
+  // usual "i < N" against the constant bounds.
+  int64_t Hello::getTripCount(Loop *loop) {
+    if (exitCompare == NULL || inductionStep == 0 || !hasLowerBound)
+      return -1;
+    BranchInst *BI = dyn_cast<BranchInst>(loop->getHeader()->getTerminator());
+    if (BI == NULL || !BI->isConditional() || BI->getCondition() != exitCompare
+          || !loop->contains(BI->getSuccessor(0)))
+      return -1;
+    
+    int64_t step = inductionStep;
+    switch (exitCompare->getPredicate()) {
+    case CmpInst::ICMP_SLT :
+      if (step > 0)
+        return upperBound > lowerBound ? 
+                (upperBound - lowerBound + step - 1) / step : 0;
+      break;
+    case CmpInst::ICMP_SLE :
+      if (step > 0)
+        return upperBound >= lowerBound ? 
+                (upperBound - lowerBound) / step + 1 : 0;
+      break;
+    case CmpInst::ICMP_SGT :
+      if (step < 0)
+        return lowerBound > upperBound ? 
+                (lowerBound - upperBound - step - 1) / -step : 0;
+      break;
+    case CmpInst::ICMP_SGE :
+      if (step < 0)
+        return lowerBound >= upperBound ? 
+                (lowerBound - upperBound) / -step + 1 : 0;
+      break;
+    default :
+      break;
+    }
+    return -1;
+  }
+  
+  // True if nothing in the loop but writer (may be NULL) can write base
+  bool Hello::isOnlyWriter(Loop *loop, Value *base, Instruction *writer) {
+    for (auto block = loop->block_begin(); block != loop->block_end(); ++block) {
+      for (auto &I : **block) {
+        if (&I == writer || !I.mayWriteToMemory())
+          continue;
+        StoreInst *SI = dyn_cast<StoreInst>(&I);
+        if (SI == NULL)
+          return false;
+        Value *object = GetUnderlyingObject(SI->getPointerOperand(), *DL);
+        if (isa<GetElementPtrInst>(SI->getPointerOperand()))
+          object = getBase(cast<Instruction>(SI->getPointerOperand()));
+        if (getAliasResult(object, base) != NoAlias)
+          return false;
       }
+    }
+    return true;
+  }
+  
+  // Loads element index of the array accessed through array (a GEP in the
+  // loop body) right before the loop. NULL if its base is computed in
+  // the loop and cannot be rebuilt there.
+  Value* Hello::cloneToPreheader(Loop *loop, Instruction *array, 
+                                 int64_t index) {
+    AllocaInst *spill = NULL;
+    for (unsigned i = 0; i + 1 < array->getNumOperands(); ++i) {
+      Instruction *op = dyn_cast<Instruction>(array->getOperand(i));
+      if (op == NULL || !loop->contains(op))
+        continue;
       
-      if(stateA->RHS_name == stateB->LHS_name) {
-        if (stateA->RHSIndex < stateB->LHSIndex) {
-          return true;     
+      // only the -O0 reload of a pointer parameter can be redone
+      LoadInst *LI = dyn_cast<LoadInst>(op);
+      AllocaInst *AI = LI ? dyn_cast<AllocaInst>(LI->getPointerOperand()) : NULL;
+      if (i != 0 || AI == NULL || loopVariant.count(AI))
+        return NULL;
+      spill = AI;
+    }
+    
+    Instruction *insertPt = loop->getLoopPreheader()->getTerminator();
+    Instruction *gep = array->clone();
+    if (spill != NULL)
+      gep->setOperand(0, new LoadInst(spill, "", insertPt));
+    
+    Value *last = gep->getOperand(gep->getNumOperands() - 1);
+    gep->setOperand(gep->getNumOperands() - 1, 
+                    ConstantInt::get(last->getType(), index));
+    gep->insertBefore(insertPt);
+    return new LoadInst(gep, "", insertPt);
+  }
+  
+  bool Hello::addReuse(std::vector<ReuseCandidate> &candidates, 
+                       Instruction *source, Value *value, 
+                       Instruction *sourceArray, Value *sourceBase, 
+                       AffineIndex sourceIndex, LoadInst *use, 
+                       Value *useBase, AffineIndex useIndex) {
+    if (use == NULL || source == use || value->getType() != use->getType()
+          || !sourceIndex.valid || !useIndex.valid 
+          || sourceIndex.coef == 0 || sourceIndex.coef != useIndex.coef 
+          || getAliasResult(sourceBase, useBase) != MustAlias)
+      return false;
+    
+    for (auto &candidate : candidates) {
+      if (candidate.use == use)
+        return false;
+    }
+    
+    int64_t stride = sourceIndex.coef * inductionStep;
+    int64_t diff = sourceIndex.constant - useIndex.constant;
+    if (diff % stride != 0)
+      return false;
+    int64_t distance = diff / stride;
+    if (distance < 1 || distance > MaxReuseDistance)
+      return false;
+    
+    ReuseCandidate candidate;
+    candidate.source = source;
+    candidate.value = value;
+    candidate.sourceArray = sourceArray;
+    candidate.sourceIndex = sourceIndex;
+    candidate.use = use;
+    candidate.distance = distance;
+    candidates.push_back(candidate);
+    return true;
+  }
+  
+  // Scalar replacement: a load of what a store (flow dependence) or
+  // another load (input dependence) accessed d iterations earlier is fed
+  // from d phis in the header rotated once per iteration:
+  //
+  //   r1 = phi [A[lb-1], preheader], [v,  latch]
+  //   r2 = phi [A[lb-2], preheader], [r1, latch]   ...
+  //
+  // The stores stay, the array is still read after the loop.
+  bool Hello::replaceScalars(Loop *loop) {
+    BasicBlock *preheader = loop->getLoopPreheader();
+    BasicBlock *latch = loop->getLoopLatch();
+    BasicBlock *header = loop->getHeader();
+    BasicBlock *body = *(loop->block_begin() + 1);
+    if (preheader == NULL || latch == NULL || accessList.empty())
+      return false;
+    
+    // The body has to run exactly once per iteration, and the stored
+    // values fed to the phis must be available on the latch edge
+    if (body != latch && (body->getSingleSuccessor() != latch 
+                            || latch->getSinglePredecessor() != body))
+      return false;
+    
+    int64_t tripCount = getTripCount(loop);
+    if (tripCount < 0)
+      return false;
+    
+    // Affine array accesses of the body, the element a load reads first
+    // (A[i+1] of A[i-1] + A[i] + A[i+1]) feeds the others
+    std::vector<AccessStruct*> stores, loads;
+    for (auto access : accessList) {
+      if (access->Inst == NULL || access->Inst->getParent() != body 
+            || !access->Affine.valid)
+        continue;
+      if (access->isWrite)
+        stores.push_back(access);
+      else
+        loads.push_back(access);
+    }
+    int64_t direction = inductionStep < 0 ? -1 : 1;
+    std::stable_sort(loads.begin(), loads.end(), 
+                     [direction](AccessStruct *loadA, AccessStruct *loadB) {
+      return loadA->Affine.constant * loadA->Affine.coef * direction > 
+               loadB->Affine.constant * loadB->Affine.coef * direction;
+    });
+    
+    std::vector<ReuseCandidate> candidates;
+    for (auto store : stores) {
+      if (!isOnlyWriter(loop, store->Base, store->Inst))
+        continue;
+      for (auto use : loads) {
+        addReuse(candidates, store->Inst, 
+                 cast<StoreInst>(store->Inst)->getValueOperand(), 
+                 store->Array, store->Base, store->Affine, 
+                 cast<LoadInst>(use->Inst), use->Base, use->Affine);
+      }
+    }
+    for (auto load : loads) {
+      if (!isOnlyWriter(loop, load->Base, NULL))
+        continue;
+      for (auto use : loads) {
+        addReuse(candidates, load->Inst, load->Inst, load->Array, 
+                 load->Base, load->Affine, cast<LoadInst>(use->Inst), 
+                 use->Base, use->Affine);
+      }
+    }
+    
+    // A load that is replaced cannot feed a chain of its own
+    std::set<Instruction*> replaced;
+    for (auto &candidate : candidates)
+      replaced.insert(candidate.use);
+    candidates.erase(std::remove_if(candidates.begin(), candidates.end(), 
+                                    [&replaced](ReuseCandidate &candidate) {
+                                      return replaced.count(candidate.source);
+                                    }), candidates.end());
+    
+    // Every value read before the first iteration must be one the loop
+    // itself would read
+    std::map<Instruction*, int64_t> chainLength;
+    for (auto &candidate : candidates) {
+      if (candidate.distance <= tripCount)
+        chainLength[candidate.source] = std::max(chainLength[candidate.source], 
+                                                 candidate.distance);
+    }
+    
+    std::map<Instruction*, std::vector<PHINode*> > chains;
+    for (auto &entry : chainLength) {
+      Instruction *source = entry.first;
+      ReuseCandidate *first = NULL;
+      for (auto &candidate : candidates) {
+        if (candidate.source == source) {
+          first = &candidate;
+          break;
         }
       }
+      
+      // The array is addressed the same way for every k, so either all
+      // initial values can be loaded or none
+      std::vector<Value*> initial;
+      for (int64_t k = 1; k <= entry.second; ++k) {
+        int64_t index = first->sourceIndex.coef * (lowerBound - k * inductionStep)
+                          + first->sourceIndex.constant;
+        Value *init = cloneToPreheader(loop, first->sourceArray, index);
+        if (init == NULL)
+          break;
+        initial.push_back(init);
+      }
+      if (initial.empty())
+        continue;
+      
+      std::vector<PHINode*> &chain = chains[source];
+      Value *incoming = first->value;
+      for (int64_t k = 0; k < entry.second; ++k) {
+        PHINode *phi = PHINode::Create(incoming->getType(), 2, "", 
+                                       header->getFirstNonPHI());
+        phi->addIncoming(initial[k], preheader);
+        phi->addIncoming(incoming, latch);
+        chain.push_back(phi);
+        incoming = phi;
+      }
+    }
+    
+    unsigned numReplaced = 0;
+    for (auto &candidate : candidates) {
+      auto chain = chains.find(candidate.source);
+      if (chain == chains.end() || 
+            (int64_t)chain->second.size() < candidate.distance)
+        continue;
+      
+      LoadInst *use = candidate.use;
+      Instruction *array = dyn_cast<Instruction>(use->getPointerOperand());
+      accessOf[use]->Inst = NULL;
+      use->replaceAllUsesWith(chain->second[candidate.distance - 1]);
+      use->eraseFromParent();
+      if (array != NULL && array->use_empty())
+        array->eraseFromParent();
+      numReplaced++;
+    }
+    
+    if (numReplaced != 0)
+      report() << "Scalar replacement : " << numReplaced << " loads removed\n";
+    return !chains.empty();
+  }
+  
+  // Prefetches the element the access will touch PrefetchDistance
+  // iterations later, if the stream spans more than PrefetchCacheSize
+  // bytes over the whole loop (an unknown trip count is taken as large).
+  bool Hello::insertPrefetch(Loop *loop, Instruction *access, 
+                             Instruction *array, AffineIndex index, 
+                             bool isWrite) {
+    if (!index.valid || index.coef == 0 || inductionStep == 0)
+      return false;
+    
+    Type *elementTy = cast<PointerType>(array->getType())->getElementType();
+    int64_t stride = index.coef * inductionStep;
+    int64_t strideBytes = (stride < 0 ? -stride : stride) 
+                            * DL->getTypeAllocSize(elementTy);
+    int64_t tripCount = getTripCount(loop);
+    if (tripCount >= 0 && strideBytes * tripCount <= (int64_t)PrefetchCacheSize)
       return false;
+    
+    Module *M = access->getParent()->getParent()->getParent();
+    IRBuilder<> builder(access);
+    Value *subscript = getSubscript(array);
+    Value *ahead = builder.CreateAdd(subscript, 
+        ConstantInt::get(subscript->getType(), stride * PrefetchDistance));
+    
+    // Running past the end of the array is fine for a prefetch, so the
+    // address is not inbounds
+    GetElementPtrInst *gep = cast<GetElementPtrInst>(array->clone());
+    gep->setOperand(gep->getNumOperands() - 1, ahead);
+    gep->setIsInBounds(false);
+    builder.Insert(gep);
+    
+    Value *args[] = {
+      builder.CreatePointerCast(gep, builder.getInt8PtrTy()),
+      builder.getInt32(isWrite),
+      builder.getInt32(3),
+      builder.getInt32(1)
+    };
+    builder.CreateCall(Intrinsic::getDeclaration(M, Intrinsic::prefetch), args);
+    return true;
+  }
+  
+  bool Hello::insertPrefetches(Loop *loop) {
+    if (!loop->empty())
+      return false;
+    
+    // Accesses that walk the same array with the same subscript share
+    // their cache lines, one prefetch covers them all
+    std::set<std::pair<Value*, std::pair<int64_t, int64_t> > > streams;
+    unsigned numPrefetches = 0;
+    for (auto access : accessList) {
+      // the load may have been replaced by -chihmin-scalar-repl
+      if (access->Inst == NULL)
+        continue;
+      auto stream = std::make_pair(access->Base, std::make_pair(
+          access->Affine.coef, access->Affine.constant));
+      if (!streams.count(stream) && insertPrefetch(loop, access->Inst, 
+            access->Array, access->Affine, access->isWrite)) {
+        streams.insert(stream);
+        numPrefetches++;
+      }
+    }
+    
+    if (numPrefetches != 0)
+      report() << "Prefetch : " << numPrefetches << " streams prefetched\n";
+    return numPrefetches != 0;
+  }
+  
+  // Both pointers compute the same address, e.g. the two H[A[i]] of
+  // H[A[i]] = H[A[i]] + 1, which -O0 computes twice
+  bool Hello::isSameAddress(Value *ptrA, Value *ptrB) {
+    if (ptrA == ptrB)
+      return true;
+    
+    Instruction *instA = dyn_cast<Instruction>(ptrA);
+    Instruction *instB = dyn_cast<Instruction>(ptrB);
+    if (instA == NULL || instB == NULL || !instA->isSameOperationAs(instB))
+      return false;
+    if (instA->mayHaveSideEffects() || isa<CallInst>(instA) || isa<PHINode>(instA))
+      return false;
+    
+    for (unsigned i = 0; i < instA->getNumOperands(); ++i) {
+      if (!isSameAddress(instA->getOperand(i), instB->getOperand(i)))
+        return false;
+    }
+    return true;
+  }
+  
+  // "c ? a : b" at -O0: the block ending in br c jumps to one arm for a
+  // and one for b, the phi joining them gives the result
+  CmpInst* Hello::getArmsOfPhi(PHINode *phi, Value *&trueValue, 
+                               Value *&falseValue) {
+    if (phi->getNumIncomingValues() != 2)
+      return NULL;
+    BasicBlock *armA = phi->getIncomingBlock(0);
+    BasicBlock *armB = phi->getIncomingBlock(1);
+    BasicBlock *cond = armA->getSinglePredecessor();
+    if (cond == NULL || armB->getSinglePredecessor() != cond 
+          || armA->getSingleSuccessor() != phi->getParent() 
+          || armB->getSingleSuccessor() != phi->getParent())
+      return NULL;
+    
+    BranchInst *BI = dyn_cast<BranchInst>(cond->getTerminator());
+    if (BI == NULL || !BI->isConditional())
+      return NULL;
+    if (BI->getSuccessor(0) == armA && BI->getSuccessor(1) == armB) {
+      trueValue = phi->getIncomingValue(0);
+      falseValue = phi->getIncomingValue(1);
+    } else if (BI->getSuccessor(0) == armB && BI->getSuccessor(1) == armA) {
+      trueValue = phi->getIncomingValue(1);
+      falseValue = phi->getIncomingValue(0);
+    } else {
+      return NULL;
+    }
+    return dyn_cast<CmpInst>(BI->getCondition());
+  }
+  
+  // Kind of reduction inst performs on the value stored at ptr. acc gets
+  // the loads of the accumulator, cmp the compare of a min/max. Empty if
+  // it is none.
+  StringRef Hello::getReductionKind(Instruction *inst, Value *ptr, 
+                                    std::vector<LoadInst*> &acc, 
+                                    CmpInst *&cmp) {
+    acc.clear();
+    cmp = NULL;
+    if (BinaryOperator *BI = dyn_cast<BinaryOperator>(inst)) {
+      bool isFP = BI->getType()->isFloatingPointTy();
+      if (isFP && !FPReduction && !BI->hasUnsafeAlgebra())
+        return "";
+      
+      StringRef kind;
+      switch (BI->getOpcode()) {
+      case Instruction::Add :  kind = "add";  break;
+      case Instruction::Mul :  kind = "mul";  break;
+      case Instruction::And :  kind = "and";  break;
+      case Instruction::Or :   kind = "or";   break;
+      case Instruction::Xor :  kind = "xor";  break;
+      case Instruction::FAdd : kind = "fadd"; break;
+      case Instruction::FMul : kind = "fmul"; break;
+      default :
+        return "";
+      }
+      
+      for (unsigned i = 0; i < 2; ++i) {
+        LoadInst *LI = dyn_cast<LoadInst>(BI->getOperand(i));
+        LoadInst *other = dyn_cast<LoadInst>(BI->getOperand(1 - i));
+        if (LI == NULL || !isSameAddress(LI->getPointerOperand(), ptr))
+          continue;
+        // acc = acc + acc is not a reduction
+        if (other != NULL && isSameAddress(other->getPointerOperand(), ptr))
+          return "";
+        acc.push_back(LI);
+        return kind;
+      }
+      return "";
+    }
+    
+    // acc = x < acc ? x : acc and the like, a select or the phi of a ?:
+    Value *trueValue, *falseValue;
+    if (SelectInst *SI = dyn_cast<SelectInst>(inst)) {
+      cmp = dyn_cast<CmpInst>(SI->getCondition());
+      trueValue = SI->getTrueValue();
+      falseValue = SI->getFalseValue();
+    } else if (PHINode *phi = dyn_cast<PHINode>(inst)) {
+      cmp = getArmsOfPhi(phi, trueValue, falseValue);
+    }
+    if (cmp == NULL)
+      return "";
+    bool isFP = isa<FCmpInst>(cmp);
+    if (isFP && !FPReduction)
+      return "";
+    
+    // -O0 loads x and acc again in the arms, so the values are compared
+    // by what they load
+    Value *lhs = cmp->getOperand(0), *rhs = cmp->getOperand(1);
+    bool sameOrder = isSameAddress(lhs, trueValue) 
+                      && isSameAddress(rhs, falseValue);
+    bool swapped = isSameAddress(lhs, falseValue) 
+                      && isSameAddress(rhs, trueValue);
+    if (!sameOrder && !swapped)
+      return "";
+    
+    bool isLess;
+    switch (cmp->getPredicate()) {
+    case CmpInst::ICMP_SLT : case CmpInst::ICMP_SLE :
+    case CmpInst::ICMP_ULT : case CmpInst::ICMP_ULE :
+    case CmpInst::FCMP_OLT : case CmpInst::FCMP_OLE :
+    case CmpInst::FCMP_ULT : case CmpInst::FCMP_ULE :
+      isLess = true;
+      break;
+    case CmpInst::ICMP_SGT : case CmpInst::ICMP_SGE :
+    case CmpInst::ICMP_UGT : case CmpInst::ICMP_UGE :
+    case CmpInst::FCMP_OGT : case CmpInst::FCMP_OGE :
+    case CmpInst::FCMP_UGT : case CmpInst::FCMP_UGE :
+      isLess = false;
+      break;
+    default :
+      return "";
+    }
+    
+    Value *operands[] = { lhs, rhs, trueValue, falseValue };
+    for (Value *op : operands) {
+      LoadInst *LI = dyn_cast<LoadInst>(op);
+      if (LI != NULL && isSameAddress(LI->getPointerOperand(), ptr) 
+            && std::find(acc.begin(), acc.end(), LI) == acc.end())
+        acc.push_back(LI);
+    }
+    // exactly one side of the compare is the accumulator
+    if (acc.empty() || isSameAddress(lhs, rhs))
+      return "";
+    
+    // select(a < b, a, b) is the minimum
+    bool isMin = (isLess == sameOrder);
+    if (isFP)
+      return isMin ? "fmin" : "fmax";
+    return isMin ? "min" : "max";
+  }
+  
+  Value* Hello::getAccessBase(Value *ptr) {
+    if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(ptr))
+      return getBase(GEP);
+    return GetUnderlyingObject(ptr, *DL);
+  }
+  
+  ReductionStruct* Hello::getReduction(Loop *loop, StoreInst *SI) {
+    Instruction *value = dyn_cast<Instruction>(SI->getValueOperand());
+    if (value == NULL)
+      return NULL;
+    
+    std::vector<LoadInst*> acc;
+    CmpInst *cmp;
+    StringRef kind = getReductionKind(value, SI->getPointerOperand(), acc, cmp);
+    if (kind.empty())
+      return NULL;
+    
+    // The running value must not be used by anything else, B[i] = (s += x)
+    // is a prefix scan
+    if (!value->hasOneUse() || (cmp != NULL && !cmp->hasOneUse()))
+      return NULL;
+    for (auto load : acc) {
+      for (User *U : load->users()) {
+        if (U != value && U != cmp)
+          return NULL;
+      }
+    }
+    
+    // Nothing else in the loop may read or write the accumulator
+    Value *base = getAccessBase(SI->getPointerOperand());
+    for (auto block = loop->block_begin(); block != loop->block_end(); ++block) {
+      for (auto &I : **block) {
+        if (&I == SI || std::find(acc.begin(), acc.end(), &I) != acc.end())
+          continue;
+        
+        Value *ptr;
+        if (LoadInst *LI = dyn_cast<LoadInst>(&I))
+          ptr = LI->getPointerOperand();
+        else if (StoreInst *store = dyn_cast<StoreInst>(&I))
+          ptr = store->getPointerOperand();
+        else if (I.mayReadOrWriteMemory())
+          return NULL;
+        else
+          continue;
+        
+        if (getAliasResult(getAccessBase(ptr), base) != NoAlias)
+          return NULL;
+      }
+    }
+    
+    bool isHistogram = false;
+    if (GetElementPtrInst *GEP = dyn_cast<GetElementPtrInst>(SI->getPointerOperand())) {
+      // B[i] = B[i] + x touches a new element every iteration, there is
+      // nothing to accumulate
+      AffineIndex index = getAffine(loop, getSubscript(GEP));
+      if (index.valid && index.coef != 0)
+        return NULL;
+      isHistogram = !index.valid;
+    }
+    
+    ReductionStruct *reduction = new ReductionStruct();
+    reduction->Store = SI;
+    reduction->Load = acc.front();
+    reduction->Base = base;
+    reduction->kind = kind;
+    reduction->isHistogram = isHistogram;
+    return reduction;
+  }
+  
+  // Value of AI when the loop is entered: the constant of the last store
+  // to AI on the single-predecessor path up from the preheader. False if
+  // that store is not a constant, is not found, or AI's address escapes.
+  bool Hello::getReachingConstant(Loop *loop, AllocaInst *AI, int64_t &value) {
+    for (User *U : AI->users()) {
+      StoreInst *SI = dyn_cast<StoreInst>(U);
+      if (!isa<LoadInst>(U) && (SI == NULL || SI->getPointerOperand() != AI))
+        return false;
+    }
+    
+    std::set<BasicBlock*> visited;
+    for (BasicBlock *block = loop->getLoopPreheader(); 
+           block != NULL && visited.insert(block).second; 
+           block = block->getSinglePredecessor()) {
+      for (auto I = block->rbegin(), E = block->rend(); I != E; ++I) {
+        StoreInst *SI = dyn_cast<StoreInst>(&*I);
+        if (SI == NULL || SI->getPointerOperand() != AI)
+          continue;
+        ConstantInt *constInt = dyn_cast<ConstantInt>(SI->getValueOperand());
+        if (constInt == NULL)
+          return false;
+        value = constInt->getSExtValue();
+        return true;
+      }
+    }
+    return false;
+  }
+  
+  // Same walk as getIndex, but keeps the induction variable symbolic.
+  // Loop invariant variables must have a known value on entry.
+  AffineIndex Hello::getAffine(Loop *loop, Value *param) {
+    if (CastInst *cast = dyn_cast<CastInst>(param)) {
+      return getAffine(loop, cast->getOperand(0));
+    }
+    else if (BinaryOperator *BI = dyn_cast<BinaryOperator>(param)) {
+      AffineIndex A = getAffine(loop, BI->getOperand(0));
+      AffineIndex B = getAffine(loop, BI->getOperand(1));
+      if (!A.valid || !B.valid)
+        return AffineIndex();
+      
+      switch(BI->getOpcode()) {
+      case Instruction::Add :
+        return AffineIndex(A.coef + B.coef, A.constant + B.constant);
+      
+      case Instruction::Sub :
+        return AffineIndex(A.coef - B.coef, A.constant - B.constant);
+      
+      case Instruction::Mul :
+        if (A.coef == 0)
+          return AffineIndex(A.constant * B.coef, A.constant * B.constant);
+        if (B.coef == 0)
+          return AffineIndex(A.coef * B.constant, A.constant * B.constant);
+        break;
+      
+      case Instruction::SDiv :
+        if (B.coef == 0 && B.constant != 0 && A.coef % B.constant == 0 
+              && A.constant % B.constant == 0)
+          return AffineIndex(A.coef / B.constant, A.constant / B.constant);
+        break;
+      }
+      return AffineIndex();
+    }
+    else if (ConstantInt *constInt = dyn_cast<ConstantInt>(param)) {
+      return AffineIndex(0, constInt->getSExtValue());
+    }
+    else if (LoadInst *LI = dyn_cast<LoadInst>(param)) {
+      AllocaInst *AI = dyn_cast<AllocaInst>(LI->getOperand(0));
+      if (AI != NULL && AI == inductionVar)
+        return AffineIndex(1, 0);
+      int64_t value;
+      if (AI != NULL && !loopVariant.count(AI) 
+            && getReachingConstant(loop, AI, value))
+        return AffineIndex(0, value);
+    }
+    return AffineIndex();
+  }
+  
+  unsigned Hello::testDependence(StateStruct *stateA, StateStruct *stateB) {
+    unsigned verdict = 0;
+    if (isFlowDependence(stateA, stateB)) 
+      verdict |= FLOW_DEPENDENCE;
+    if (isAntiDependence(stateA, stateB)) 
+      verdict |= ANTI_DEPENDENCE;
+    if (isOutputDependence(stateA, stateB)) 
+      verdict |= OUTPUT_DEPENDENCE;
+    return verdict;
+  }
+  
+  // Bases that provably never overlap are skipped, bases that may overlap
+  // are assumed dependent and only MustAlias bases compare subscripts.
+  bool Hello::isFlowDependence(StateStruct *stateA, StateStruct *stateB) {
+    if (stateA->LHS != NULL) {
+      for (auto read : stateB->RHS) {
+        AliasResult alias = getAccessAlias(stateA->LHS, read);
+        if (alias == MustAlias) {
+          if (stateA->LHS->Index >= read->Index) {
+            return true;    
+          }
+        } else if (alias != NoAlias) {
+          return true;
+        }
+      }
+    }
+    
+    if (stateB->LHS != NULL) {
+      for (auto read : stateA->RHS) {
+        AliasResult alias = getAccessAlias(read, stateB->LHS);
+        if (alias == MustAlias) {
+          if (read->Index < stateB->LHS->Index) {
+            return true;     
+          }
+        } else if (alias != NoAlias) {
+          return true;
+        }
+      }
+    }
+    return false;
   }
 
   bool Hello::isAntiDependence(StateStruct *stateA, StateStruct *stateB) {
-      if (stateA->LHS_name == stateB->RHS_name) {
-        if (stateA->LHSIndex < stateB->RHSIndex) {
-          return true;    
+    if (stateA->LHS != NULL) {
+      for (auto read : stateB->RHS) {
+        AliasResult alias = getAccessAlias(stateA->LHS, read);
+        if (alias == MustAlias) {
+          if (stateA->LHS->Index < read->Index) {
+            return true;    
+          }
+        } else if (alias != NoAlias) {
+          return true;
         }
       }
-      
-      if(stateA->RHS_name == stateB->LHS_name) {
-        if (stateA->RHSIndex >= stateB->LHSIndex) {
-          return true;     
+    }
+    
+    if (stateB->LHS != NULL) {
+      for (auto read : stateA->RHS) {
+        AliasResult alias = getAccessAlias(read, stateB->LHS);
+        if (alias == MustAlias) {
+          if (read->Index >= stateB->LHS->Index) {
+            return true;     
+          }
+        } else if (alias != NoAlias) {
+          return true;
         }
       }
-      return false;
+    }
+    return false;
   }
 
   bool Hello::isOutputDependence(StateStruct *stateA, StateStruct *stateB) {
-    if (stateA->LHS_name == stateB->LHS_name)
+    if (stateA->LHS == NULL || stateB->LHS == NULL)
+      return false;
+    if (getAliasResult(stateA->LHS->Base, stateB->LHS->Base) != NoAlias)
       return true;
     return false;
   }
+  
+  // A statement against its own instances: a write and a read of the same
+  // array with the same stride meet d = (c1 - c2) / stride iterations
+  // apart, a flow dependence if d > 0 and an anti dependence if d < 0.
+  // Subscripts that are not known or do not move with i meet every
+  // iteration.
+  unsigned Hello::testSelfDependence(StateStruct *state) {
+    AccessStruct *write = state->LHS;
+    if (write == NULL)
+      return 0;
+    
+    unsigned verdict = 0;
+    if (!write->Affine.valid || write->Affine.coef == 0 || inductionStep == 0)
+      verdict |= OUTPUT_DEPENDENCE;
+    
+    for (auto read : state->RHS) {
+      AliasResult alias = getAccessAlias(write, read);
+      if (alias == NoAlias)
+        continue;
+      if (alias != MustAlias || write->Affine.coef != read->Affine.coef 
+            || inductionStep == 0) {
+        verdict |= FLOW_DEPENDENCE | ANTI_DEPENDENCE;
+        continue;
+      }
+      
+      int64_t diff = write->Affine.constant - read->Affine.constant;
+      if (write->Affine.coef == 0) {
+        if (diff == 0)
+          verdict |= FLOW_DEPENDENCE | ANTI_DEPENDENCE;
+        continue;
+      }
+      int64_t stride = write->Affine.coef * inductionStep;
+      if (diff == 0 || diff % stride != 0)
+        continue;
+      verdict |= diff / stride > 0 ? FLOW_DEPENDENCE : ANTI_DEPENDENCE;
+    }
+    return verdict;
+  }
 
   void Hello::detectDependence() {
-    for (int i = 1; i < (int)stateList.size(); ++i) {
-      for (int j = i - 1; j >= 0; j--) {
+    for (int i = 0; i < (int)stateList.size(); ++i) {
+      for (int j = i; j >= 0; j--) {
         StateStruct *stateB = stateList[i];
         StateStruct *stateA = stateList[j];
         
@@ -303,18 +1826,20 @@ namespace {
         // printState(stateB);
         DEBUG(errs() << ")\n");
        
-        if (isFlowDependence(stateA, stateB)) { 
+        unsigned verdict = (i == j) ? testSelfDependence(stateB) 
+                                    : testDependence(stateA, stateB);
+        if (verdict & FLOW_DEPENDENCE) { 
           flowDependence.push_back(
               std::pair<StateStruct*, StateStruct*>(stateA, stateB)
           );
         }
         
-        if (isAntiDependence(stateA, stateB)) { 
+        if (verdict & ANTI_DEPENDENCE) { 
           antiDependence.push_back(
               std::pair<StateStruct*, StateStruct*>(stateA, stateB)
           );
         }
-        if (isOutputDependence(stateA, stateB)) { 
+        if (verdict & OUTPUT_DEPENDENCE) { 
           outputDependence.push_back(
               std::pair<StateStruct*, StateStruct*>(stateA, stateB)
           );
@@ -324,40 +1849,72 @@ namespace {
   }
  
   void Hello::reportDependence() {
-    errs() << "Number of FlowDependence : " << flowDependence.size() << "\n";
+    report() << "Number of FlowDependence : " << flowDependence.size() << "\n";
     for (auto &dep : flowDependence) {
       StateStruct *stateA = dep.first;
       StateStruct *stateB = dep.second;
       printState(stateA);
       printState(stateB);
-      errs() << "\n";
+      report() << "\n";
     }
 
     
-    errs() << "Number of AntiDependence : " << antiDependence.size() << "\n";
+    report() << "Number of AntiDependence : " << antiDependence.size() << "\n";
     for (auto &dep : antiDependence) {
       StateStruct *stateA = dep.first;
       StateStruct *stateB = dep.second;
       printState(stateA);
       printState(stateB);
-      errs() << "\n";
+      report() << "\n";
     }
 
-    errs() << "Number of OutputDependence : " << outputDependence.size() << "\n";
+    report() << "Number of OutputDependence : " << outputDependence.size() << "\n";
     for (auto &dep : outputDependence) {
       StateStruct *stateA = dep.first;
       StateStruct *stateB = dep.second;
       printState(stateA);
       printState(stateB);
-      errs() << "\n";
+      report() << "\n";
+    }
+    
+    report() << "Number of Reduction : " << reductionList.size() << "\n";
+    for (auto reduction : reductionList) {
+      printReduction(reduction);
+    }
+    report() << "\n";
+    
+    if (numSkipped != 0) {
+      report() << "Loop is not analyzed : " << numSkipped 
+               << " statements skipped\n";
+    } else if (flowDependence.empty() && antiDependence.empty() 
+                 && outputDependence.empty()) {
+      if (reductionList.empty())
+        report() << "Loop is dependence free\n";
+      else
+        report() << "Loop is dependence free except for reductions\n";
     }
   }
   
+  void Hello::printReduction(ReductionStruct *reduction) {
+    report() << reduction->Base->getName() 
+           << (reduction->isHistogram ? "[..]" : "") 
+           << " : " << reduction->kind << " reduction\n";
+  }
+  
+  // A[3] = B[2], C[3] for a statement, ... = B[2] for a read
   void Hello::printState(StateStruct *state) {
-      errs() << state->LHS_name << "[" 
-              << state->LHSIndex << "]" 
-              << " = " << state->RHS_name << "["
-              << state->RHSIndex << "]\n"; 
+      if (state->LHS != NULL)
+        report() << state->LHS->Name << "[" << state->LHS->Index << "]";
+      else
+        report() << "...";
+      report() << " = ";
+      if (state->RHS.empty())
+        report() << "...";
+      for (unsigned i = 0; i < state->RHS.size(); ++i) {
+        report() << (i == 0 ? "" : ", ") << state->RHS[i]->Name << "[" 
+                 << state->RHS[i]->Index << "]";
+      }
+      report() << "\n"; 
   }
 
   bool Hello::isTargetInst(Instruction *inst) {
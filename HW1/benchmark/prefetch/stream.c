@@ -0,0 +1,61 @@
+#include <stdio.h>
+#include <time.h>
+
+/* Sizes come from the Makefile, e.g. make N=8388608 STRIDE=16 */
+#ifndef N
+#define N 1048576
+#endif
+#ifndef STRIDE
+#define STRIDE 16
+#endif
+#ifndef REPS
+#define REPS 10
+#endif
+
+int A[N * STRIDE], B[N], C[N];
+
+void copy() {
+    for (int i = 0; i < N; ++i) {
+        B[i] = A[i];
+    }
+}
+
+void gather() {
+    for (int i = 0; i < N; ++i) {
+        C[i] = A[STRIDE * i];
+    }
+}
+
+void reverse() {
+    for (int i = N - 1; i >= 0; --i) {
+        C[i] = B[i];
+    }
+}
+
+/* Two loads and a store per element, each its own stream */
+void triad() {
+    int s = 3;
+    for (int i = 0; i < N; ++i) {
+        A[i] = B[i] + s * C[i];
+    }
+}
+
+double measure(void (*kernel)()) {
+    struct timespec begin, end;
+    clock_gettime(CLOCK_MONOTONIC, &begin);
+    for (int r = 0; r < REPS; ++r)
+        kernel();
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    return (end.tv_sec - begin.tv_sec) * 1e3 + (end.tv_nsec - begin.tv_nsec) / 1e6;
+}
+
+int main(int argc, const char *argv[]){
+    for (int i = 0; i < N * STRIDE; ++i)
+        A[i] = i;
+
+    printf("copy    : %8.2f ms\n", measure(copy));
+    printf("gather  : %8.2f ms\n", measure(gather));
+    printf("reverse : %8.2f ms\n", measure(reverse));
+    printf("triad   : %8.2f ms\n", measure(triad));
+    return 0;
+}
@@ -0,0 +1,237 @@
+/*
+ * Runtime of the ChihMin dynamic dependence profiler.
+ *
+ * opt -chihmin -chihmin-profile hooks every array access of the loops it
+ * cannot analyze statically into the functions below. The last write and
+ * the last read of every granule are kept in a shadow memory hash table,
+ * an access that touches a granule used by an earlier iteration of the
+ * same loop invocation is a cross-iteration dependence. The observed distances are
+ * dumped per loop when the program exits, to stderr or to the file named
+ * by CHIHMIN_PROFILE.
+ */
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define MAX_DISTANCE 16
+
+/* Granules are 1 << GRANULE_SHIFT bytes, accesses that share one overlap.
+ * The default of 4 bytes keeps one entry per int or float element, build
+ * with -DGRANULE_SHIFT=0 to keep neighbouring elements of char and short
+ * arrays apart. */
+#ifndef GRANULE_SHIFT
+#define GRANULE_SHIFT 2
+#endif
+
+enum { FLOW, ANTI, OUTPUT, NUM_KINDS };
+
+static const char *kindName[NUM_KINDS] = { "flow", "anti", "output" };
+
+typedef struct LoopRecord {
+  const char *name;
+  uint64_t invocation;
+  uint64_t iteration;
+  uint64_t totalIterations;
+  /* the header holds the exit test, as in for and while loops */
+  int headerExits;
+  /* distance 1 .. MAX_DISTANCE, the last bucket counts everything farther */
+  uint64_t distance[NUM_KINDS][MAX_DISTANCE + 1];
+  struct LoopRecord *next;
+} LoopRecord;
+
+typedef struct ShadowEntry {
+  uintptr_t granule;
+  LoopRecord *loop; /* NULL for a free entry */
+  uint64_t invocation;
+  uint64_t lastWrite;
+  uint64_t lastRead;
+  unsigned char hasWrite, hasRead;
+} ShadowEntry;
+
+static LoopRecord *loopList = NULL;
+static ShadowEntry *shadow = NULL;
+static size_t shadowSize = 0, shadowUsed = 0;
+
+static size_t hashGranule(uintptr_t granule, LoopRecord *loop) {
+  uint64_t key = (uint64_t)granule ^ ((uint64_t)(uintptr_t)loop << 17);
+  key ^= key >> 33;
+  key *= 0xff51afd7ed558ccdULL;
+  key ^= key >> 33;
+  return (size_t)key;
+}
+
+static ShadowEntry *findEntry(ShadowEntry *table, size_t size,
+                              uintptr_t granule, LoopRecord *loop) {
+  size_t mask = size - 1;
+  size_t i = hashGranule(granule, loop) & mask;
+  while (table[i].loop != NULL &&
+         (table[i].granule != granule || table[i].loop != loop))
+    i = (i + 1) & mask;
+  return &table[i];
+}
+
+/* Entries of an earlier invocation never conflict again */
+static int isStale(ShadowEntry *entry) {
+  return entry->invocation != entry->loop->invocation;
+}
+
+/* Rehashes the entries of the current invocations, the table only grows
+ * if they fill more than a quarter of it */
+static void growShadow(void) {
+  size_t newSize = shadowSize ? shadowSize : (1 << 16);
+  size_t live = 0, i;
+  ShadowEntry *table;
+
+  for (i = 0; i < shadowSize; ++i) {
+    if (shadow[i].loop != NULL && !isStale(&shadow[i]))
+      live++;
+  }
+  if (4 * (live + 1) > newSize)
+    newSize *= 2;
+
+  table = calloc(newSize, sizeof(ShadowEntry));
+  if (table == NULL) {
+    fprintf(stderr, "[chihmin-profile] out of memory\n");
+    exit(1);
+  }
+  for (i = 0; i < shadowSize; ++i) {
+    if (shadow[i].loop != NULL && !isStale(&shadow[i]))
+      *findEntry(table, newSize, shadow[i].granule, shadow[i].loop) = shadow[i];
+  }
+  free(shadow);
+  shadow = table;
+  shadowSize = newSize;
+  shadowUsed = live;
+}
+
+static void record(LoopRecord *loop, int kind, uint64_t from) {
+  uint64_t distance = loop->iteration - from;
+  if (distance > MAX_DISTANCE)
+    distance = MAX_DISTANCE + 1;
+  loop->distance[kind][distance - 1]++;
+}
+
+static void dumpProfile(void) {
+  const char *path = getenv("CHIHMIN_PROFILE");
+  FILE *out = path ? fopen(path, "w") : NULL;
+  LoopRecord *loop;
+  int kind, d;
+
+  if (out == NULL)
+    out = stderr;
+
+  for (loop = loopList; loop != NULL; loop = loop->next) {
+    int dependent = 0;
+    fprintf(out, "Loop %s : %llu invocations, %llu iterations\n", loop->name,
+            (unsigned long long)loop->invocation,
+            (unsigned long long)loop->totalIterations);
+
+    for (kind = 0; kind < NUM_KINDS; ++kind) {
+      for (d = 0; d <= MAX_DISTANCE; ++d) {
+        if (loop->distance[kind][d] == 0)
+          continue;
+        dependent = 1;
+        if (d == MAX_DISTANCE)
+          fprintf(out, "\t%s distance > %d : %llu\n", kindName[kind],
+                  MAX_DISTANCE, (unsigned long long)loop->distance[kind][d]);
+        else
+          fprintf(out, "\t%s distance %d : %llu\n", kindName[kind], d + 1,
+                  (unsigned long long)loop->distance[kind][d]);
+      }
+    }
+
+    if (!dependent)
+      fprintf(out, "\tno cross-iteration dependence observed\n");
+  }
+
+  if (out != stderr)
+    fclose(out);
+}
+
+void __chihmin_loop_begin(LoopRecord **slot, const char *name,
+                          int headerExits) {
+  LoopRecord *loop = *slot;
+  if (loop == NULL) {
+    if (loopList == NULL)
+      atexit(dumpProfile);
+    loop = calloc(1, sizeof(LoopRecord));
+    loop->name = name;
+    loop->headerExits = headerExits;
+    loop->next = loopList;
+    loopList = loop;
+    *slot = loop;
+  }
+  loop->invocation++;
+  loop->iteration = 0;
+}
+
+/* Called each time the header runs. A header that holds the exit test
+ * runs once more than the body, so there only the headers reached
+ * through the back edge count as iterations. */
+void __chihmin_loop_iter(LoopRecord **slot) {
+  LoopRecord *loop = *slot;
+  if (loop->iteration != 0 || !loop->headerExits)
+    loop->totalIterations++;
+  loop->iteration++;
+}
+
+/* Keeps the latest earlier iteration that conflicts with the access */
+static void noteConflict(uint64_t *from, int *found, int kind,
+                         uint64_t iteration) {
+  if (!found[kind] || iteration > from[kind])
+    from[kind] = iteration;
+  found[kind] = 1;
+}
+
+void __chihmin_access(LoopRecord **slot, const char *addr, int size,
+                      int isWrite) {
+  LoopRecord *loop = *slot;
+  uintptr_t first = (uintptr_t)addr >> GRANULE_SHIFT;
+  uintptr_t last =
+    ((uintptr_t)addr + (size > 0 ? size : 1) - 1) >> GRANULE_SHIFT;
+  uint64_t from[NUM_KINDS];
+  int found[NUM_KINDS] = { 0, 0, 0 };
+  uintptr_t granule;
+  int kind;
+
+  for (granule = first; granule <= last; ++granule) {
+    ShadowEntry *entry;
+
+    if (2 * (shadowUsed + 1) > shadowSize)
+      growShadow();
+
+    entry = findEntry(shadow, shadowSize, granule, loop);
+    if (entry->loop == NULL) {
+      entry->granule = granule;
+      entry->loop = loop;
+      shadowUsed++;
+    }
+
+    if (isStale(entry)) {
+      entry->invocation = loop->invocation;
+      entry->hasWrite = entry->hasRead = 0;
+    }
+
+    if (isWrite) {
+      if (entry->hasWrite && entry->lastWrite < loop->iteration)
+        noteConflict(from, found, OUTPUT, entry->lastWrite);
+      if (entry->hasRead && entry->lastRead < loop->iteration)
+        noteConflict(from, found, ANTI, entry->lastRead);
+      entry->lastWrite = loop->iteration;
+      entry->hasWrite = 1;
+    } else {
+      if (entry->hasWrite && entry->lastWrite < loop->iteration)
+        noteConflict(from, found, FLOW, entry->lastWrite);
+      entry->lastRead = loop->iteration;
+      entry->hasRead = 1;
+    }
+  }
+
+  /* An access is counted once however many granules it spans */
+  for (kind = 0; kind < NUM_KINDS; ++kind) {
+    if (found[kind])
+      record(loop, kind, from[kind]);
+  }
+}
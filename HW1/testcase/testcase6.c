@@ -0,0 +1,19 @@
+#include <stdio.h>
+
+int main(int argc, const char *argv[]){
+    int A[20], B[20], C[20], H[20];
+    int sum = 0;
+    int prod = 1;
+    int m = 100;
+    for (int i = 3; i < 20; ++i) {
+        sum = sum + A[i];
+        prod = prod * A[i-1];
+        B[0] = B[0] + A[i];
+        H[A[i]] = H[A[i]] + 1;
+        C[i] = A[i-1];
+    }
+    for (int i = 0; i < 20; ++i) {
+        m = A[i] < m ? A[i] : m;
+    }
+    return 0;
+}
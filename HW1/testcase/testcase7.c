@@ -0,0 +1,22 @@
+#include <stdio.h>
+
+int G[20];
+
+void add(int *restrict a, int *restrict b, int n) {
+    for (int i = 1; i < n; ++i) {
+        a[i] = b[i] + G[i];
+        G[i] = a[i-1];
+        b[i] = b[i-1] * 2;
+    }
+}
+
+int main(int argc, const char *argv[]){
+    int A[20], B[20];
+    int t = 0;
+    add(A, B, 20);
+    for (int i = 0; i < 20; ++i) {
+        t = A[i];
+        B[i] = t;
+    }
+    return 0;
+}
@@ -0,0 +1,9 @@
+#include <stdio.h>
+
+int main(int argc, const char *argv[]){
+    int A[20], B[20];
+    for (int i = 1; i < 19; ++i) {
+        B[i] = A[i-1] + A[i] + A[i+1];
+    }
+    return 0;
+}
@@ -27,9 +27,27 @@
 #include "llvm/IR/DerivedTypes.h"
 #include "llvm/IR/Constants.h"
 #include "llvm/Support/Casting.h"
+#include "llvm/Support/CommandLine.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Analysis/CallGraph.h"
+#include "llvm/Analysis/ValueTracking.h"
+#include "llvm/ADT/SCCIterator.h"
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/PostOrderIterator.h"
+#include "llvm/ADT/iterator_range.h"
+#include "llvm/IR/CallSite.h"
+#include "llvm/IR/Module.h"
+#include "llvm/Transforms/Utils/Local.h"
+#include "DataFlow.h"
 #include <vector>
 #include <string>
 #include <map>
+#include <set>
+#include <atomic>
+#include <thread>
+#include <unordered_map>
 
 using namespace llvm;
 
@@ -39,350 +57,875 @@ using namespace llvm;
 
 // STATISTIC(Flow_dependence, "Counts number of flow dependece");
 
+STATISTIC(NumDeadStores, "Number of dead stores removed");
+
+static cl::opt<unsigned> SummaryThreads("callsummary-threads", cl::init(0),
+    cl::desc("Threads used to summarize independent call graph SCCs "
+             "(0 = one per core, one under chihmin-batch)"));
+
+// chihmin-batch hands out one buffer per input through this hook, it is
+// undefined when the plugin is loaded into opt.
+extern "C" LLVM_ATTRIBUTE_WEAK raw_ostream *chihmin_report_stream();
+
+static raw_ostream &report() {
+  if (chihmin_report_stream != NULL) {
+    if (raw_ostream *OS = chihmin_report_stream())
+      return *OS;
+  }
+  return errs();
+}
+
 namespace {
   
-  struct Expression {
-    Value *left, *right;
-    Value *tar;
-    unsigned int opcode;
+  // What a call to the function may write besides its own locals:
+  // globals, memory reached through its pointer arguments, or anything
+  // at all when it calls or writes through something unknown.
+  struct FunctionSummary {
+    bool writesUnknown;
+    std::set<GlobalVariable*> modGlobals;
+    std::set<unsigned> modArgs;
 
-    Expression(Value *_left, Value *_right) {
-      left = _left, right = _right;
-    }
-       
-    Expression(Value *_left, Value *_right, unsigned int _opcode) {
-      left = _left, right = _right, opcode = _opcode;
+    FunctionSummary() : writesUnknown(false) {}
+  };
+}
+
+// DataFlow.h names these two, they cannot live in an anonymous namespace
+namespace llvm {
+  struct CallSummary : public ModulePass {
+    static char ID;
+    std::map <Function*, FunctionSummary> summaries;
+    const DataLayout *DL;
+
+    CallSummary() : ModulePass(ID) {}
+
+    FunctionSummary* getSummary(Function *F) {
+      auto it = summaries.find(F);
+      if (it == summaries.end())
+        return NULL;
+      return &it->second;
     }
     
-    void setLeft(Value *v) {
-      this->left = v;
+    Value* getSpilledArgument(AllocaInst *AI) {
+      Value *arg = NULL;
+      for (User *U : AI->users()) {
+        if (StoreInst *SI = dyn_cast<StoreInst>(U)) {
+          if (SI->getPointerOperand() != AI || arg != NULL)
+            return NULL;
+          arg = SI->getValueOperand();
+        }
+      }
+      if (arg != NULL && isa<Argument>(arg))
+        return arg;
+      return NULL;
     }
 
-    void setRight(Value *v) {
-      this->right = v;
+    // Returns the alloca, global or argument a pointer points into, pointer
+    // parameters reloaded from their -O0 spill slot give the argument.
+    // NULL means the object is unknown.
+    Value* getPointedObject(Value *ptr) {
+      Value *obj = GetUnderlyingObject(ptr, *DL);
+      if (LoadInst *LI = dyn_cast<LoadInst>(obj)) {
+        if (AllocaInst *AI = dyn_cast<AllocaInst>(LI->getPointerOperand()))
+          return getSpilledArgument(AI);
+        return NULL;
+      }
+      if (isa<AllocaInst>(obj) || isa<GlobalVariable>(obj) || isa<Argument>(obj))
+        return obj;
+      return NULL;
     }
-    
-    void setOpcode(unsigned opcode) {
-      this->opcode = opcode;
+
+    void addWrite(FunctionSummary &summary, Value *obj) {
+      if (obj == NULL)
+        summary.writesUnknown = true;
+      else if (GlobalVariable *GV = dyn_cast<GlobalVariable>(obj))
+        summary.modGlobals.insert(GV);
+      else if (Argument *arg = dyn_cast<Argument>(obj))
+        summary.modArgs.insert(arg->getArgNo());
     }
 
-    Value* getLeft() {
-      return this->left;
+    bool summarize(Function *F) {
+      FunctionSummary &summary = *getSummary(F);
+      bool oldUnknown = summary.writesUnknown;
+      unsigned oldGlobals = summary.modGlobals.size();
+      unsigned oldArgs = summary.modArgs.size();
+
+      for (auto &BB : *F) {
+        for (auto &I : BB) {
+          if (StoreInst *SI = dyn_cast<StoreInst>(&I)) {
+            addWrite(summary, getPointedObject(SI->getPointerOperand()));
+            continue;
+          }
+          
+          CallSite CS(&I);
+          if (!CS) {
+            if (I.mayWriteToMemory())
+              summary.writesUnknown = true;
+            continue;
+          }
+          if (CS.onlyReadsMemory())
+            continue;
+
+          Function *callee = CS.getCalledFunction();
+          FunctionSummary *calleeSummary = callee ? getSummary(callee) : NULL;
+          if (calleeSummary == NULL || calleeSummary->writesUnknown) {
+            summary.writesUnknown = true;
+            continue;
+          }
+          summary.modGlobals.insert(calleeSummary->modGlobals.begin(), 
+                                    calleeSummary->modGlobals.end());
+          for (unsigned argNo : calleeSummary->modArgs) {
+            if (argNo < CS.arg_size())
+              addWrite(summary, getPointedObject(CS.getArgument(argNo)));
+          }
+        }
+      }
+
+      return summary.writesUnknown != oldUnknown 
+              || summary.modGlobals.size() != oldGlobals
+              || summary.modArgs.size() != oldArgs;
     }
 
-    Value* getRight() {
-      return this->right;
+    void summarizeSCC(std::vector<Function*> &scc) {
+      bool changed = true;
+      while (changed) {
+        changed = false;
+        for (auto F : scc)
+          changed |= summarize(F);
+      }
     }
 
-    unsigned int getOpcode() {
-      return this->opcode;
+    void getAnalysisUsage(AnalysisUsage &AU) const override {
+      AU.addRequired<CallGraphWrapperPass>();
+      AU.setPreservesAll();
     }
 
-    bool operator==(const Expression &expr) const {
-      if (this->left != expr.left) return false;
-      if (this->right != expr.right) return false;
-      if (this->opcode != expr.opcode) return false;
-      return true;
+    bool runOnModule(Module &M) override {
+      CallGraph &CG = getAnalysis<CallGraphWrapperPass>().getCallGraph();
+      DL = &M.getDataLayout();
+      summaries.clear();
+      
+      // scc_iterator visits callees first, so an SCC's level (one above its
+      // deepest callee) is known when it is reached. SCCs on the same level
+      // never call each other and are summarized in parallel.
+      std::vector<std::vector<Function*> > sccs;
+      std::vector<unsigned> level;
+      std::map <Function*, unsigned> sccOf;
+      unsigned maxLevel = 0;
+      for (scc_iterator<CallGraph*> it = scc_begin(&CG); !it.isAtEnd(); ++it) {
+        std::vector<Function*> members;
+        for (CallGraphNode *node : *it) {
+          Function *F = node->getFunction();
+          if (F != NULL && !F->isDeclaration())
+            members.push_back(F);
+        }
+        if (members.empty())
+          continue;
+        
+        unsigned id = sccs.size();
+        for (auto F : members) {
+          sccOf[F] = id;
+          summaries[F] = FunctionSummary();
+        }
+        
+        unsigned sccLevel = 0;
+        for (CallGraphNode *node : *it) {
+          for (auto &record : *node) {
+            Function *callee = record.second->getFunction();
+            auto calleeSCC = sccOf.find(callee);
+            if (callee != NULL && calleeSCC != sccOf.end() 
+                  && calleeSCC->second != id)
+              sccLevel = std::max(sccLevel, level[calleeSCC->second] + 1);
+          }
+        }
+        sccs.push_back(members);
+        level.push_back(sccLevel);
+        maxLevel = std::max(maxLevel, sccLevel);
+      }
+
+      // chihmin-batch already runs one input per core, a summary thread
+      // per core on top of each would oversubscribe the machine
+      unsigned numThreads = SummaryThreads;
+      if (numThreads == 0 && chihmin_report_stream != NULL)
+        numThreads = 1;
+      else if (numThreads == 0)
+        numThreads = std::max(1u, std::thread::hardware_concurrency());
+
+      for (unsigned lvl = 0; lvl <= maxLevel && !sccs.empty(); ++lvl) {
+        std::vector<unsigned> work;
+        for (unsigned i = 0; i < sccs.size(); ++i)
+          if (level[i] == lvl)
+            work.push_back(i);
+
+        std::atomic<unsigned> next(0);
+        auto worker = [&]() {
+          for (unsigned i = next++; i < work.size(); i = next++)
+            summarizeSCC(sccs[work[i]]);
+        };
+
+        std::vector<std::thread> threads;
+        for (unsigned i = 1; i < std::min<unsigned>(numThreads, work.size()); ++i)
+          threads.push_back(std::thread(worker));
+        worker();
+        for (auto &thread : threads)
+          thread.join();
+      }
+      
+      for (auto &entry : summaries) {
+        DEBUG(errs() << "Summary " << entry.first->getName() << " : "
+                     << (entry.second.writesUnknown ? "unknown, " : "")
+                     << entry.second.modGlobals.size() << " globals, "
+                     << entry.second.modArgs.size() << " arguments\n");
+      }
+      return false;
     }
   };
 
-  struct DataFlow : public FunctionPass {
-    static char ID;
-    typedef std::vector<Expression> ExprVec;
-    std::map <Instruction*, ExprVec* > IN, OUT, GEN, KILL; 
-    std::map <Instruction*, bool > isVisited; 
-     
-    DataFlow() : FunctionPass(ID){}
-     
-    void pushSet(ExprVec* v, Expression expr) {
-      bool hasElement = false;
-      for (auto element : *v) {
-        if (element == expr) {
-          hasElement = true;
+  void DataFlow::pushSet(ExprVec* v, Expression expr) {
+    bool hasElement = false;
+    for (auto element : *v) {
+      if (element == expr) {
+        hasElement = true;
+        break;
+      }
+    }
+    if (!hasElement)  
+      v->push_back(expr);   
+  }
+
+  void DataFlow::pushSetGroup(ExprVec *tarSet, ExprVec *srcSet) {
+    for (auto src : *srcSet) {
+      pushSet(tarSet, src);
+    }
+  }
+
+  void DataFlow::andSetGroup(ExprVec *tar, ExprVec *src) {
+    for (unsigned int i = 0; i < tar->size(); ++i) {
+      Expression tarElement = *(tar->begin() + i);
+      bool hasCommonElement = false;
+      for (auto srcElement : *src) {
+        if (tarElement == srcElement) {
+          hasCommonElement = true;
           break;
         }
       }
-      if (!hasElement)  
-        v->push_back(expr);   
-    } 
+      
+      if (!hasCommonElement) {
+        tar->erase(tar->begin() + i);
+        i--;
+      }
+    }
+  }
 
-    void pushSetGroup(ExprVec *tarSet, ExprVec *srcSet) {
-      for (auto src : *srcSet) {
-        pushSet(tarSet, src);
+  void DataFlow::getKillSet(ExprVec *killSet, ExprVec *inSet, Value *killedInst) {
+    for (auto inExpr : *inSet) {
+      if (inExpr.getLeft() == killedInst || inExpr.getRight() == killedInst) {
+        pushSet(killSet, inExpr);
       }
     }
+  }
 
-    void andSetGroup(ExprVec *tar, ExprVec *src) {
-      for (unsigned int i = 0; i < tar->size(); ++i) {
-        Expression tarElement = *(tar->begin() + i);
-        bool hasCommonElement = false;
-        for (auto srcElement : *src) {
-          if (tarElement == srcElement) {
-            hasCommonElement = true;
-            break;
-          }
-        }
-        
-        if (!hasCommonElement) {
-          tar->erase(tar->begin() + i);
+  bool DataFlow::isEscaped(AllocaInst *AI) {
+    for (User *U : AI->users()) {
+      if (isa<LoadInst>(U))
+        continue;
+      StoreInst *SI = dyn_cast<StoreInst>(U);
+      if (SI == NULL || SI->getPointerOperand() != AI)
+        return true;
+    }
+    return false;
+  }
+
+  // Any write the callee may do somewhere unknown: escaped locals and
+  // globals are clobbered
+  bool DataFlow::mayModifyUnknown(Value *operand) {
+    if (AllocaInst *AI = dyn_cast<AllocaInst>(operand))
+      return isEscaped(AI);
+    return true;
+  }
+
+  // A call only kills what the callee's summary says it may write,
+  // locals whose address never escapes survive any call. Operands are
+  // variables, *p (the load of p) or values that are not in memory.
+  bool DataFlow::mayModify(CallInst *call, Value *operand) {
+    if (!isa<AllocaInst>(operand) && !isa<GlobalVariable>(operand) 
+          && !isa<LoadInst>(operand))
+      return false;
+    if (call->onlyReadsMemory())
+      return false;
+
+    Function *callee = call->getCalledFunction();
+    FunctionSummary *calleeSummary =
+        callee ? summary->getSummary(callee) : NULL;
+    if (calleeSummary == NULL || calleeSummary->writesUnknown)
+      return mayModifyUnknown(operand);
+    // p may point to whatever the callee writes
+    if (isa<LoadInst>(operand))
+      return !calleeSummary->modGlobals.empty() || 
+               !calleeSummary->modArgs.empty();
+
+    GlobalVariable *GV = dyn_cast<GlobalVariable>(operand);
+    if (GV != NULL && calleeSummary->modGlobals.count(GV))
+      return true;
+    // set(&g) writes g through its argument just like set(&x) writes x
+    for (unsigned argNo : calleeSummary->modArgs) {
+      if (argNo >= call->getNumArgOperands())
+        continue;
+      Value *obj = summary->getPointedObject(call->getArgOperand(argNo));
+      if (obj == operand)
+        return true;
+      // set(gp) or set(q) of a pointer parameter q may point anywhere,
+      // only a different local or global is known not to be operand
+      if ((obj == NULL || isa<Argument>(obj)) && mayModifyUnknown(operand))
+        return true;
+    }
+    return false;
+  }
+
+  void DataFlow::getCallKillSet(ExprVec *killSet, ExprVec *inSet, CallInst *call) {
+    for (auto inExpr : *inSet) {
+      if (mayModify(call, inExpr.getLeft()) || 
+            mayModify(call, inExpr.getRight())) {
+        pushSet(killSet, inExpr);
+      }
+    }
+  }
+
+  void DataFlow::complementSet(ExprVec *mainSet, ExprVec *compSet) {
+    for (unsigned int i = 0; i < mainSet->size(); ++i) {
+     // DEBUG(errs() << i << " : " << mainSet->size() << "\n");
+      for (auto kill : *compSet) {
+        Expression in = *(mainSet->begin() + i);
+        if (in == kill) {
+          mainSet->erase(mainSet->begin() + i);
           i--;
+          break;
         }
       }
     }
+  }
 
-    void getKillSet(ExprVec *killSet, ExprVec *inSet, Value *killedInst) {
-      for (auto inExpr : *inSet) {
-        if (inExpr.getLeft() == killedInst || inExpr.getRight() == killedInst) {
-          pushSet(killSet, inExpr);
+  bool DataFlow::isSetEqual(ExprVec *setA, ExprVec *setB) {
+    if (setA->size() != setB->size())  
+      return false; 
+    else if (setA->size() == 0)
+      return true;
+
+    for (auto setAElement : *setA) {
+      bool findElement = false;
+      for (auto setBElement : *setB) 
+        if (setAElement == setBElement) 
+          findElement = true;
+      
+      if (!findElement) 
+        return false;
+    }
+    return true;
+  }
+
+  StringRef DataFlow::getOperatorChar(unsigned int opcode) {
+    StringRef op;
+    switch(opcode) {
+    case Instruction::Add :
+      op = " + ";
+      break;
+
+    case Instruction::Sub :
+      op = " - ";
+      break;
+
+    case Instruction::Mul :
+      op = " * ";  
+      break;
+
+    case Instruction::SDiv :
+      op = " / ";
+      break;
+    }
+    
+    return op;
+  }
+
+  // *p is named after the variable p is loaded from
+  void DataFlow::print_operand(Value *operand) {
+    if (LoadInst *LI = dyn_cast<LoadInst>(operand))
+      report() << "*" << LI->getPointerOperand()->getName();
+    else
+      report() << operand->getName();
+  }
+
+  void DataFlow::print_expression(Value *left, Value *right, StringRef op) {
+    print_operand(left);
+    if (ConstantInt *constRight = dyn_cast<ConstantInt>(right)) 
+      report() << op << constRight->getSExtValue() << ", ";
+    else {
+      report() << op;
+      print_operand(right);
+      report() << ", ";
+    }
+  }
+
+  void DataFlow::print_set(ExprVec *v) {
+    if (v->size() == 0)
+      report() << "[EMPTY]";
+
+    for (auto element : *v) {
+      unsigned int opcode = element.getOpcode();
+      StringRef op = getOperatorChar(opcode);
+      Value *left = element.left;
+      Value *right = element.right;
+      print_expression(left, right, op);  
+    }
+    report() << "\n";
+  }
+
+  void DataFlow::printStatus(BasicBlock *block) {
+    report() << "[ " << block->getName() << " ]\n";
+    for (auto it = block->begin(); it != block->end(); ++it) {
+      Instruction *inst = it;
+      if (StoreInst *strInst = dyn_cast<StoreInst>(inst)) {
+        // errs() << ">>>> " << *inst << "\n"; 
+        Value *left = strInst->getOperand(1);
+        Value *right = strInst->getOperand(0);
+        StringRef op;
+        
+        report() << "\t>>>> ";
+        print_operand(left);
+        report() << " = ";
+        if (BinaryOperator *BI = dyn_cast<BinaryOperator>(right)) { 
+          op = getOperatorChar(BI->getOpcode());
+          Value *OperandA = BI->getOperand(0);
+          Value *OperandB = BI->getOperand(1);
+          
+          if (isa<ConstantInt>(OperandA))
+            std::swap(OperandA, OperandB);
+           
+          if (LoadInst *LI = dyn_cast<LoadInst>(OperandA))
+            OperandA = LI->getOperand(0);
+
+          if (LoadInst *LI = dyn_cast<LoadInst>(OperandB))
+            OperandB = LI->getOperand(0);
+          //  errs() << *OperandA << " " << *OperandB << "\n";
+          print_expression(OperandA, OperandB, op);
+          report() << "\n";
         }
+        else if (ConstantInt *CI = dyn_cast<ConstantInt>(right)) {
+          report() << CI->getSExtValue() << "\n";
+        }
+        else {
+          // a = b, or the spill of a parameter p.addr = p
+          if (LoadInst *LI = dyn_cast<LoadInst>(right))
+            right = LI->getOperand(0);
+          print_operand(right);
+          report() << "\n";
+        }
+        
+        report() << "\t\te_IN : "; 
+          print_set(IN[inst]);
+        
+        report() << "\t\te_OUT : ";
+          print_set(OUT[inst]);
+        
+        report() << "\t\te_GEN : ";
+          print_set(GEN[inst]);
+        
+        report() << "\t\te_KILL : ";
+          print_set(KILL[inst]);
       }
     }
+  }
+
+  // Operands are named by the variable they are loaded from, so the same
+  // expression computed at two places compares equal.
+  Expression DataFlow::makeExpression(BinaryOperator *expr) {
+    Value *instA = expr->getOperand(0);
+    Value *instB = expr->getOperand(1);
+    
+    if (LoadInst *load = dyn_cast<LoadInst>(instA)) 
+      instA = load->getOperand(0);
+       
+    if (LoadInst *load = dyn_cast<LoadInst>(instB))
+      instB = load->getOperand(0);  
+    
+    if (instA > instB) 
+      std::swap(instA, instB);
     
-    void complementSet(ExprVec *mainSet, ExprVec *compSet) {
-      for (unsigned int i = 0; i < mainSet->size(); ++i) {
-       // DEBUG(errs() << i << " : " << mainSet->size() << "\n");
-        for (auto kill : *compSet) {
-          Expression in = *(mainSet->begin() + i);
-          if (in == kill) {
-            mainSet->erase(mainSet->begin() + i);
-            i--;
+    if (isa<ConstantInt>(instA))
+      std::swap(instA, instB);
+    
+    return Expression(instA, instB, expr->getOpcode());
+  }
+
+  BitVector DataFlow::toBitVector(ExprVec *v) {
+    BitVector set(result.getNumExpressions());
+    if (v == NULL)
+      return set;
+    for (auto expr : *v)
+      set.set(result.getIndex(expr));
+    return set;
+  }
+
+  // Turns the solved sets of F into the query form. Blocks without a
+  // store or call have no IN set of their own, their entry is the
+  // intersection of their predecessors' exits.
+  void DataFlow::buildResult(Function &F) {
+    result.clear();
+    for (auto &BB : F) {
+      for (auto &I : BB) {
+        if (!isVisited.count(&I))
+          continue;
+        for (auto expr : *IN[&I])
+          result.addExpression(expr);
+        for (auto expr : *OUT[&I])
+          result.addExpression(expr);
+      }
+    }
+    
+    BitVector full(result.getNumExpressions(), true);
+    std::map <BasicBlock*, BitVector> exitSet;
+    ReversePostOrderTraversal<Function*> RPOT(&F);
+    bool changed = true;
+    while (changed) {
+      changed = false;
+      for (BasicBlock *BB : RPOT) {
+        BitVector set = full;
+        Instruction *first = NULL;
+        for (auto &I : *BB) {
+          if (isVisited.count(&I)) {
+            first = &I;
             break;
           }
         }
+        
+        if (first != NULL) {
+          set = toBitVector(IN[first]);
+        } else if (BB == &F.getEntryBlock()) {
+          set.reset();
+        } else {
+          for (pred_iterator it = pred_begin(BB); it != pred_end(BB); ++it) {
+            auto exit = exitSet.find(*it);
+            if (exit != exitSet.end())
+              set &= exit->second;
+          }
+        }
+        
+        for (auto &I : *BB) {
+          if (isVisited.count(&I))
+            set = toBitVector(OUT[&I]);
+        }
+        
+        auto exit = exitSet.find(BB);
+        if (exit == exitSet.end() || exit->second != set) {
+          exitSet[BB] = set;
+          changed = true;
+        }
       }
     }
     
-    bool isSetEqual(ExprVec *setA, ExprVec *setB) {
-      if (setA->size() != setB->size())  
-        return false; 
-      else if (setA->size() == 0)
-        return true;
-
-      for (auto setAElement : *setA) {
-        bool findElement = false;
-        for (auto setBElement : *setB) 
-          if (setAElement == setBElement) 
-            findElement = true;
-        
-        if (!findElement) 
-          return false;
+    for (auto &BB : F) {
+      BitVector set(result.getNumExpressions());
+      Instruction *first = NULL;
+      for (auto &I : BB) {
+        if (isVisited.count(&I)) {
+          first = &I;
+          break;
+        }
+      }
+      
+      if (first != NULL) {
+        set = toBitVector(IN[first]);
+      } else if (&BB != &F.getEntryBlock() && pred_begin(&BB) != pred_end(&BB)) {
+        set = full;
+        for (pred_iterator it = pred_begin(&BB); it != pred_end(&BB); ++it)
+          set &= exitSet[*it];
+      }
+      
+      unsigned current = result.addSet(set);
+      result.setEntry(&BB, current);
+      for (auto &I : BB) {
+        result.setPoint(&I, current);
+        if (isVisited.count(&I))
+          current = result.addSet(toBitVector(OUT[&I]));
       }
-      return true;
     }
-     
-    StringRef getOperatorChar(unsigned int opcode) {
-      StringRef op;
-      switch(opcode) {
-      case Instruction::Add :
-        op = " + ";
-        break;
+  }
 
-      case Instruction::Sub :
-        op = " - ";
-        break;
+  void DataFlow::mergeInSet(Instruction *inst, ExprVec *in_set, Instruction *lastInst) {
+    if (lastInst != NULL) {
+      ExprVec *prevOutSet = OUT[lastInst];
+      if (isVisited.find(inst) == isVisited.end() ) {
+        pushSetGroup(in_set, prevOutSet);
+      } else {
+        DEBUG(errs() << "constand ANDSET!!\n");
+        andSetGroup(in_set, prevOutSet);    
+      }
+    }
+  }
 
-      case Instruction::Mul :
-        op = " * ";  
-        break;
+  void DataFlow::traverse(BasicBlock *child, Instruction *lastInst) {
+    // Instruction *lastInst = parent;
+    for (auto bt = child->begin(); bt != child->end(); ++bt) {
+      Instruction *inst = bt;
+      //DEBUG(errs() << "> Current address : " << inst << "\n");
+      if (IN.find(inst) == IN.end()) {
+        ExprVec *in_v = new ExprVec();
+        ExprVec *out_v = new ExprVec();
+        ExprVec *gen_v = new ExprVec();
+        ExprVec *kill_v = new ExprVec();
+        
+        IN[inst] = in_v;
+        OUT[inst] = out_v;
+        GEN[inst] = gen_v;
+        KILL[inst] = kill_v;
+      }
 
-      case Instruction::SDiv :
-        op = " / ";
-        break;
+      ExprVec *in_set = IN[inst];
+      ExprVec *out_set = OUT[inst];
+      ExprVec *gen_set = GEN[inst];
+      ExprVec *kill_set = KILL[inst];
+      
+      if (StoreInst *strInst = dyn_cast<StoreInst>(inst)) { 
+        Value *operand = strInst->getOperand(0);
+        Value *target;
+        if (BinaryOperator *expr = dyn_cast<BinaryOperator>(operand)) {
+          Expression genExpr = makeExpression(expr);
+          Value *instA = genExpr.getLeft(), *instB = genExpr.getRight();
+          target = strInst->getOperand(1);
+          
+          /* Here only handle only one block testcase */
+          if (target != instA && target != instB)
+            pushSet(gen_set, genExpr);
+          //  DEBUG(errs() << "out_set_orig : " << out_set->size()<< "\n");
+          
+          DEBUG(errs() << "\t(" << *target << ")" <<  " = ("  << *instA 
+                        << ") operand (" << *instB << " " << instB << ") ");
+          DEBUG(errs() << "\n");
+        } else {
+          target = bt->getOperand(1); 
+          DEBUG(errs() << "\t" << *target << "\n");   
+        }
+        
+        /***** KILL SET ******/
+        mergeInSet(inst, in_set, lastInst);
+        // kill  
+        getKillSet(kill_set, in_set, target);      
+      } else if (CallInst *call = dyn_cast<CallInst>(inst)) {
+        mergeInSet(inst, in_set, lastInst);
+        getCallKillSet(kill_set, in_set, call);
+      } else {
+        continue;
+      }
+      
+      ExprVec compSet;
+      for (auto it = in_set->begin(); it != in_set->end(); ++it) {
+        Expression exprIn = *it;
+        compSet.push_back(exprIn);
       }
+      complementSet(&compSet, kill_set);
+      
+      ExprVec *tempOutSet = new ExprVec();
+         
+      //out_set->clear();
+      pushSetGroup(tempOutSet, gen_set);
+      pushSetGroup(tempOutSet, &compSet);
       
-      return op;
+      if (isVisited.find(inst) != isVisited.end() 
+            && isSetEqual(out_set, tempOutSet)) return; 
+      else {
+        out_set->clear();
+        pushSetGroup(out_set, tempOutSet);
+        delete tempOutSet;
+      }
+      isVisited[inst] = 1;
+      lastInst = inst;  // update last instruction 
     }
+    // find next node 
+    for (succ_iterator it = succ_begin(child); it != succ_end(child); ++it) {
+      DEBUG(errs() << it->getName() << "\n");
+      BasicBlock *block = *it;
+      traverse(block, lastInst);
+    }
+  }
+
+  void DataFlow::getAnalysisUsage(AnalysisUsage &AU) const {
+    AU.addRequired<CallSummary>();
+    AU.setPreservesAll();
+  }
+
+  bool DataFlow::runOnFunction(Function &F) {
+    summary = &getAnalysis<CallSummary>();
+    DEBUG(errs() << "DataFlow : ");
+    report().write_escaped(F.getName()) << "\n";
     
-    void print_expression(Value *left, Value *right, StringRef op) {
-      if (ConstantInt *constRight = dyn_cast<ConstantInt>(right)) 
-        errs() << left->getName() << op << constRight->getSExtValue() << ", ";
-      else
-        errs() <<  left->getName() << op << right->getName() << ", ";
+
+    Function::iterator block = F.begin(); // get first basic block
+    DEBUG(errs() << block->getName() << "\n");
+    BasicBlock *bb = block;
+    
+    traverse(bb, NULL);    
+    buildResult(F);
+    for (auto blockIt = F.begin(); blockIt != F.end(); ++blockIt) { 
+      BasicBlock *block = blockIt;
+      printStatus(block);
     }
+    
+    return false;
+  }
+}
 
-    void print_set(ExprVec *v) {
-      if (v->size() == 0)
-        errs() << "[EMPTY]";
+namespace {
+  // Backward liveness of the local variables, i.e. the allocas that are
+  // only loaded and stored directly, followed by dead store elimination:
+  // a store to a variable that is not live right after it is removed.
+  struct DeadStore : public FunctionPass {
+    static char ID;
+    std::map <AllocaInst*, unsigned> varIndex;
+    std::vector <AllocaInst*> vars;
+    std::map <BasicBlock*, BitVector> USE, DEF, LiveIn, LiveOut;
 
-      for (auto element : *v) {
-        unsigned int opcode = element.getOpcode();
-        StringRef op = getOperatorChar(opcode);
-        Value *left = element.left;
-        Value *right = element.right;
-        print_expression(left, right, op);  
+    DeadStore() : FunctionPass(ID) {}
+
+    bool isLocalVariable(AllocaInst *AI) {
+      for (User *U : AI->users()) {
+        if (LoadInst *LI = dyn_cast<LoadInst>(U)) {
+          if (LI->isVolatile())
+            return false;
+          continue;
+        }
+        StoreInst *SI = dyn_cast<StoreInst>(U);
+        if (SI == NULL || SI->getPointerOperand() != AI || SI->isVolatile())
+          return false;
       }
-      errs() << "\n";
+      return true;
     }
 
-    void printStatus(BasicBlock *block) {
-      errs() << "[ " << block->getName() << " ]\n";
-      for (auto it = block->begin(); it != block->end(); ++it) {
-        Instruction *inst = it;
-        if (StoreInst *strInst = dyn_cast<StoreInst>(inst)) {
-          // errs() << ">>>> " << *inst << "\n"; 
-          Value *left = strInst->getOperand(1);
-          Value *right = strInst->getOperand(0);
-          StringRef op;
-          
-          errs() << "\t>>>> " << left->getName() << " = ";
-          if (BinaryOperator *BI = dyn_cast<BinaryOperator>(right)) { 
-            op = getOperatorChar(BI->getOpcode());
-            Value *OperandA = BI->getOperand(0);
-            Value *OperandB = BI->getOperand(1);
-            
-            if (isa<ConstantInt>(OperandA))
-              std::swap(OperandA, OperandB);
-             
-            if (LoadInst *LI = dyn_cast<LoadInst>(OperandA))
-              OperandA = LI->getOperand(0);
-
-            if (LoadInst *LI = dyn_cast<LoadInst>(OperandB))
-              OperandB = LI->getOperand(0);
-            //  errs() << *OperandA << " " << *OperandB << "\n";
-            print_expression(OperandA, OperandB, op);
-            errs() << "\n";
-          }
-          else {
-            ConstantInt *CI = dyn_cast<ConstantInt>(right);
-            errs() << CI->getSExtValue() << "\n";
-          }
-          
-          errs() << "\t\te_IN : "; 
-            print_set(IN[inst]);
-          
-          errs() << "\t\te_OUT : ";
-            print_set(OUT[inst]);
-          
-          errs() << "\t\te_GEN : ";
-            print_set(GEN[inst]);
-          
-          errs() << "\t\te_KILL : ";
-            print_set(KILL[inst]);
-        }
+    // Index of the variable inst loads or stores, -1 for other memory
+    int getVariable(Instruction *inst) {
+      Value *ptr;
+      if (LoadInst *LI = dyn_cast<LoadInst>(inst))
+        ptr = LI->getPointerOperand();
+      else if (StoreInst *SI = dyn_cast<StoreInst>(inst))
+        ptr = SI->getPointerOperand();
+      else
+        return -1;
+
+      AllocaInst *AI = dyn_cast<AllocaInst>(ptr);
+      if (AI == NULL || varIndex.find(AI) == varIndex.end())
+        return -1;
+      return varIndex[AI];
+    }
+
+    void computeUseDef(BasicBlock *block) {
+      BitVector use(vars.size()), def(vars.size());
+      for (auto &I : *block) {
+        int var = getVariable(&I);
+        if (var < 0)
+          continue;
+        if (isa<LoadInst>(I) && !def.test(var))
+          use.set(var);
+        else if (isa<StoreInst>(I))
+          def.set(var);
       }
+      USE[block] = use;
+      DEF[block] = def;
     }
 
-    void traverse(BasicBlock *child, Instruction *lastInst) {
-      // Instruction *lastInst = parent;
-      for (auto bt = child->begin(); bt != child->end(); ++bt) {
-        Instruction *inst = bt;
-        //DEBUG(errs() << "> Current address : " << inst << "\n");
-        if (IN.find(inst) == IN.end()) {
-          ExprVec *in_v = new ExprVec();
-          ExprVec *out_v = new ExprVec();
-          ExprVec *gen_v = new ExprVec();
-          ExprVec *kill_v = new ExprVec();
-          
-          IN[inst] = in_v;
-          OUT[inst] = out_v;
-          GEN[inst] = gen_v;
-          KILL[inst] = kill_v;
-        }
+    void computeLiveness(Function &F) {
+      for (auto &BB : F) {
+        computeUseDef(&BB);
+        LiveIn[&BB] = BitVector(vars.size());
+        LiveOut[&BB] = BitVector(vars.size());
+      }
 
-        ExprVec *in_set = IN[inst];
-        ExprVec *out_set = OUT[inst];
-        ExprVec *gen_set = GEN[inst];
-        ExprVec *kill_set = KILL[inst];
-        
-        if (StoreInst *strInst = dyn_cast<StoreInst>(inst)) { 
-          Value *operand = strInst->getOperand(0);
-          Value *target;
-          if (BinaryOperator *expr = dyn_cast<BinaryOperator>(operand)) {
-            Value *instA, *instB;
-            
-            unsigned opcode = expr->getOpcode();
-            instA = expr->getOperand(0);
-            instB = expr->getOperand(1);
-            target = strInst->getOperand(1);
-            
-            if (LoadInst *load = dyn_cast<LoadInst>(instA)) 
-              instA = load->getOperand(0);
-               
-            if (LoadInst *load = dyn_cast<LoadInst>(instB))
-              instB = load->getOperand(0);  
-            
-            if (instA > instB) 
-              std::swap(instA, instB);
-            
-            if (isa<ConstantInt>(instA))
-              std::swap(instA, instB);
-            
-            /* Here only handle only one block testcase */
-            if (target != instA && target != instB)
-              pushSet(gen_set, Expression(instA, instB, opcode));
-            //  DEBUG(errs() << "out_set_orig : " << out_set->size()<< "\n");
-            
-            DEBUG(errs() << "\t(" << *target << ")" <<  " = ("  << *instA 
-                          << ") operand (" << *instB << " " << instB << ") ");
-            DEBUG(errs() << "\n");
-          } else {
-            target = bt->getOperand(1); 
-            DEBUG(errs() << "\t" << *target << "\n");   
-          }
-          
-          /***** KILL SET ******/
-          if (lastInst != NULL) {
-            ExprVec *prevOutSet = OUT[lastInst];
-            if (isVisited.find(inst) == isVisited.end() ) {
-              pushSetGroup(in_set, prevOutSet);
-            } else {
-              DEBUG(errs() << "constand ANDSET!!\n");
-              andSetGroup(in_set, prevOutSet);    
-            }
-          }
-          // kill  
-          getKillSet(kill_set, in_set, target);      
-          ExprVec compSet;
-          for (auto it = in_set->begin(); it != in_set->end(); ++it) {
-            Expression exprIn = *it;
-            compSet.push_back(exprIn);
-          }
-          complementSet(&compSet, kill_set);
-          
-          ExprVec *tempOutSet = new ExprVec();
-             
-          //out_set->clear();
-          pushSetGroup(tempOutSet, gen_set);
-          pushSetGroup(tempOutSet, &compSet);
-          
-          if (isVisited.find(inst) != isVisited.end() 
-                && isSetEqual(out_set, tempOutSet)) return; 
-          else {
-            out_set->clear();
-            pushSetGroup(out_set, tempOutSet);
-            delete tempOutSet;
+      bool changed = true;
+      while (changed) {
+        changed = false;
+        for (po_iterator<Function*> it = po_begin(&F), e = po_end(&F); 
+               it != e; ++it) {
+          BasicBlock *block = *it;
+          BitVector out(vars.size());
+          for (succ_iterator it = succ_begin(block); it != succ_end(block); ++it)
+            out |= LiveIn[*it];
+
+          BitVector in = out;
+          in.reset(DEF[block]);
+          in |= USE[block];
+
+          if (in != LiveIn[block] || out != LiveOut[block]) {
+            LiveIn[block] = in;
+            LiveOut[block] = out;
+            changed = true;
           }
-          isVisited[inst] = 1;
-          lastInst = inst;  // update last instruction 
         }
       }
-      // find next node 
-      for (succ_iterator it = succ_begin(child); it != succ_end(child); ++it) {
-        DEBUG(errs() << it->getName() << "\n");
-        BasicBlock *block = *it;
-        traverse(block, lastInst);
+    }
+
+    void printLiveness(Function &F) {
+      for (auto &BB : F) {
+        DEBUG(errs() << "[ " << BB.getName() << " ] live out :");
+        for (int i = LiveOut[&BB].find_first(); i >= 0; 
+               i = LiveOut[&BB].find_next(i))
+          DEBUG(errs() << " " << vars[i]->getName());
+        DEBUG(errs() << "\n");
       }
     }
 
     bool runOnFunction(Function &F) override {
-      DEBUG(errs() << "DataFlow : ");
-      errs().write_escaped(F.getName()) << "\n";
-      
+      report() << "DeadStore : ";
+      report().write_escaped(F.getName()) << "\n";
 
-      Function::iterator block = F.begin(); // get first basic block
-      DEBUG(errs() << block->getName() << "\n");
-      BasicBlock *bb = block;
-      
-      traverse(bb, NULL);    
-      for (auto blockIt = F.begin(); blockIt != F.end(); ++blockIt) { 
-        BasicBlock *block = blockIt;
-        printStatus(block);
+      varIndex.clear();
+      vars.clear();
+      USE.clear(), DEF.clear(), LiveIn.clear(), LiveOut.clear();
+      for (auto &I : F.getEntryBlock()) {
+        AllocaInst *AI = dyn_cast<AllocaInst>(&I);
+        if (AI != NULL && isLocalVariable(AI)) {
+          varIndex[AI] = vars.size();
+          vars.push_back(AI);
+        }
       }
-      
-      return false;
+
+      computeLiveness(F);
+      printLiveness(F);
+
+      std::vector<StoreInst*> deadStores;
+      for (auto &BB : F) {
+        BitVector live = LiveOut[&BB];
+        for (auto it = BB.rbegin(); it != BB.rend(); ++it) {
+          Instruction *inst = &*it;
+          int var = getVariable(inst);
+          if (var < 0)
+            continue;
+          if (isa<LoadInst>(inst)) {
+            live.set(var);
+          } else if (!live.test(var)) {
+            deadStores.push_back(cast<StoreInst>(inst));
+          } else {
+            live.reset(var);
+          }
+        }
+      }
+
+      for (auto store : deadStores) {
+        report() << "\t>>>> " << store->getPointerOperand()->getName() 
+               << " is not live after the store, removed\n";
+        Value *value = store->getValueOperand();
+        store->eraseFromParent();
+        RecursivelyDeleteTriviallyDeadInstructions(value);
+      }
+      NumDeadStores += deadStores.size();
+      report() << "Number of dead stores : " << deadStores.size() << "\n";
+
+      return !deadStores.empty();
     }
   };
 }
 
+char DeadStore::ID = 0;
+static RegisterPass<DeadStore> Z("deadstore", "Dead Store Elimination Pass");
+
+char CallSummary::ID = 0;
+static RegisterPass<CallSummary> Y("callsummary", "Call Summary Analysis Pass", 
+                                   false, true);
+
 char DataFlow::ID = 2;
 static RegisterPass<DataFlow> X("dataflow", "DataFlow Analysis Pass");
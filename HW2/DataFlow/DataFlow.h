@@ -0,0 +1,245 @@
+//===- DataFlow.h - Available expressions of a function ---------*- C++ -*-===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// The "dataflow" pass solves the available expressions of a function.
+// Passes in this plugin or another one loaded next to it can require it
+// and query the result:
+//
+//   DataFlow &DF = getAnalysis<DataFlow>();
+//   Expression expr = DF.makeExpression(BI);
+//   if (DF.getResult().isAvailableAt(expr, SI)) ...
+//
+//===----------------------------------------------------------------------===//
+
+#ifndef CHIHMIN_DATAFLOW_H
+#define CHIHMIN_DATAFLOW_H
+
+#include "llvm/ADT/BitVector.h"
+#include "llvm/ADT/DenseMap.h"
+#include "llvm/ADT/Hashing.h"
+#include "llvm/ADT/iterator_range.h"
+#include "llvm/IR/Function.h"
+#include "llvm/IR/Instructions.h"
+#include "llvm/Pass.h"
+#include <map>
+#include <unordered_map>
+#include <vector>
+
+namespace llvm {
+  
+  struct Expression {
+    Value *left, *right;
+    Value *tar;
+    unsigned int opcode;
+
+    Expression(Value *_left, Value *_right) {
+      left = _left, right = _right;
+    }
+       
+    Expression(Value *_left, Value *_right, unsigned int _opcode) {
+      left = _left, right = _right, opcode = _opcode;
+    }
+    
+    void setLeft(Value *v) {
+      this->left = v;
+    }
+
+    void setRight(Value *v) {
+      this->right = v;
+    }
+    
+    void setOpcode(unsigned opcode) {
+      this->opcode = opcode;
+    }
+
+    Value* getLeft() {
+      return this->left;
+    }
+
+    Value* getRight() {
+      return this->right;
+    }
+
+    unsigned int getOpcode() {
+      return this->opcode;
+    }
+
+    bool operator==(const Expression &expr) const {
+      if (this->left != expr.left) return false;
+      if (this->right != expr.right) return false;
+      if (this->opcode != expr.opcode) return false;
+      return true;
+    }
+  };
+
+  struct ExpressionHash {
+    size_t operator()(const Expression &expr) const {
+      return hash_combine(expr.left, expr.right, expr.opcode);
+    }
+  };
+
+  // Query interface over the solved IN sets of one function. Every
+  // distinct expression owns a bit, every instruction maps to the bit
+  // vector that holds right before it, so a query is one hash lookup and
+  // one bit test, and whole sets can be combined a word at a time.
+  class AvailableExpressions {
+    std::vector<Expression> exprs;
+    std::unordered_map<Expression, unsigned, ExpressionHash> exprIndex;
+    std::vector<BitVector> sets;
+    DenseMap<const Instruction*, unsigned> pointSet;
+    DenseMap<const BasicBlock*, unsigned> entrySet;
+    BitVector emptySet;
+
+  public:
+    // Iterates the expressions of one set
+    class iterator {
+      const AvailableExpressions *AE;
+      const BitVector *set;
+      int idx;
+
+    public:
+      iterator(const AvailableExpressions *_AE, const BitVector *_set, int _idx)
+        : AE(_AE), set(_set), idx(_idx) {}
+
+      const Expression &operator*() const { return AE->getExpression(idx); }
+      const Expression *operator->() const { return &AE->getExpression(idx); }
+
+      iterator &operator++() {
+        idx = set->find_next(idx);
+        return *this;
+      }
+
+      bool operator==(const iterator &it) const { return idx == it.idx; }
+      bool operator!=(const iterator &it) const { return idx != it.idx; }
+    };
+
+    void clear() {
+      exprs.clear();
+      exprIndex.clear();
+      sets.clear();
+      pointSet.clear();
+      entrySet.clear();
+      emptySet.clear();
+    }
+
+    unsigned getNumExpressions() const { return exprs.size(); }
+
+    const Expression &getExpression(unsigned idx) const { return exprs[idx]; }
+
+    // Index of expr, -1 if it is never available in the function
+    int getIndex(const Expression &expr) const {
+      auto it = exprIndex.find(expr);
+      if (it == exprIndex.end())
+        return -1;
+      return it->second;
+    }
+
+    unsigned addExpression(const Expression &expr) {
+      auto it = exprIndex.find(expr);
+      if (it != exprIndex.end())
+        return it->second;
+      exprs.push_back(expr);
+      exprIndex[expr] = exprs.size() - 1;
+      return exprs.size() - 1;
+    }
+
+    unsigned addSet(const BitVector &set) {
+      sets.push_back(set);
+      return sets.size() - 1;
+    }
+
+    BitVector &getSet(unsigned idx) { return sets[idx]; }
+
+    void setPoint(const Instruction *inst, unsigned set) {
+      pointSet[inst] = set;
+    }
+
+    void setEntry(const BasicBlock *block, unsigned set) {
+      entrySet[block] = set;
+    }
+
+    // Expressions available right before inst
+    const BitVector &availableBefore(const Instruction *inst) const {
+      auto it = pointSet.find(inst);
+      if (it == pointSet.end())
+        return emptySet;
+      return sets[it->second];
+    }
+
+    // Expressions available on entry to block
+    const BitVector &availableExprs(const BasicBlock *block) const {
+      auto it = entrySet.find(block);
+      if (it == entrySet.end())
+        return emptySet;
+      return sets[it->second];
+    }
+
+    bool isAvailableAt(const Expression &expr, const Instruction *inst) const {
+      int idx = getIndex(expr);
+      if (idx < 0)
+        return false;
+      const BitVector &set = availableBefore(inst);
+      return (unsigned)idx < set.size() && set.test(idx);
+    }
+
+    iterator_range<iterator> reaching(const Instruction *inst) const {
+      const BitVector &set = availableBefore(inst);
+      return make_range(iterator(this, &set, set.find_first()),
+                        iterator(this, &set, -1));
+    }
+
+    iterator_range<iterator> reaching(const BasicBlock *block) const {
+      const BitVector &set = availableExprs(block);
+      return make_range(iterator(this, &set, set.find_first()),
+                        iterator(this, &set, -1));
+    }
+  };
+
+  struct CallSummary;
+
+  // Available expressions by forward traversal of the function: a store of
+  // a + b generates a + b, a store to a kills every expression reading a
+  // and a call kills what the callee's summary says it may write.
+  struct DataFlow : public FunctionPass {
+    static char ID;
+    typedef std::vector<Expression> ExprVec;
+    std::map <Instruction*, ExprVec* > IN, OUT, GEN, KILL;
+    std::map <Instruction*, bool > isVisited;
+    CallSummary *summary;
+    AvailableExpressions result;
+
+    DataFlow() : FunctionPass(ID){}
+
+    void pushSet(ExprVec* v, Expression expr);
+    void pushSetGroup(ExprVec *tarSet, ExprVec *srcSet);
+    void andSetGroup(ExprVec *tar, ExprVec *src);
+    void getKillSet(ExprVec *killSet, ExprVec *inSet, Value *killedInst);
+    bool isEscaped(AllocaInst *AI);
+    bool mayModifyUnknown(Value *operand);
+    bool mayModify(CallInst *call, Value *operand);
+    void getCallKillSet(ExprVec *killSet, ExprVec *inSet, CallInst *call);
+    void complementSet(ExprVec *mainSet, ExprVec *compSet);
+    bool isSetEqual(ExprVec *setA, ExprVec *setB);
+    StringRef getOperatorChar(unsigned int opcode);
+    void print_operand(Value *operand);
+    void print_expression(Value *left, Value *right, StringRef op);
+    void print_set(ExprVec *v);
+    void printStatus(BasicBlock *block);
+    Expression makeExpression(BinaryOperator *expr);
+    BitVector toBitVector(ExprVec *v);
+    void buildResult(Function &F);
+    const AvailableExpressions &getResult() const { return result; }
+    void mergeInSet(Instruction *inst, ExprVec *in_set, Instruction *lastInst);
+    void traverse(BasicBlock *child, Instruction *lastInst);
+    void getAnalysisUsage(AnalysisUsage &AU) const override;
+    bool runOnFunction(Function &F) override;
+  };
+}
+
+#endif
@@ -0,0 +1,82 @@
+//===- RedundantExpr.cpp - Report recomputed available expressions --------===//
+//
+//                     The LLVM Compiler Infrastructure
+//
+// This file is distributed under the University of Illinois Open Source
+// License. See LICENSE.TXT for details.
+//
+//===----------------------------------------------------------------------===//
+//
+// Reports every stored expression that is already available where it is
+// computed again, i.e. the candidates of common subexpression elimination.
+// It only goes through the query interface of DataFlow.h.
+//
+//===----------------------------------------------------------------------===//
+
+#include "DataFlow.h"
+#include "llvm/Support/Compiler.h"
+#include "llvm/Support/raw_ostream.h"
+
+using namespace llvm;
+
+// chihmin-batch hands out one buffer per input through this hook, it is
+// undefined when the plugin is loaded into opt.
+extern "C" LLVM_ATTRIBUTE_WEAK raw_ostream *chihmin_report_stream();
+
+static raw_ostream &report() {
+  if (chihmin_report_stream != NULL) {
+    if (raw_ostream *OS = chihmin_report_stream())
+      return *OS;
+  }
+  return errs();
+}
+
+namespace {
+  struct RedundantExpr : public FunctionPass {
+    static char ID;
+
+    RedundantExpr() : FunctionPass(ID) {}
+
+    void getAnalysisUsage(AnalysisUsage &AU) const override {
+      AU.addRequired<DataFlow>();
+      AU.setPreservesAll();
+    }
+
+    bool runOnFunction(Function &F) override {
+      DataFlow &DF = getAnalysis<DataFlow>();
+      const AvailableExpressions &result = DF.getResult();
+
+      report() << "RedundantExpr : ";
+      report().write_escaped(F.getName()) << "\n";
+
+      unsigned numRedundant = 0;
+      for (auto &BB : F) {
+        for (auto &I : BB) {
+          StoreInst *SI = dyn_cast<StoreInst>(&I);
+          BinaryOperator *BI =
+              SI ? dyn_cast<BinaryOperator>(SI->getValueOperand()) : NULL;
+          if (BI == NULL)
+            continue;
+
+          Expression expr = DF.makeExpression(BI);
+          if (!result.isAvailableAt(expr, SI))
+            continue;
+
+          report() << "\t>>>> ";
+          DF.print_operand(SI->getPointerOperand());
+          report() << " = ";
+          DF.print_expression(expr.getLeft(), expr.getRight(),
+                              DF.getOperatorChar(expr.getOpcode()));
+          report() << "\n";
+          numRedundant++;
+        }
+      }
+      report() << "Number of redundant expressions : " << numRedundant << "\n";
+      return false;
+    }
+  };
+}
+
+char RedundantExpr::ID = 0;
+static RegisterPass<RedundantExpr> X("redundantexpr",
+                                     "Redundant Expression Report Pass");
@@ -0,0 +1,25 @@
+#include <stdio.h>
+
+int g;
+
+void set(int *p)
+{
+    *p = 1;
+}
+
+void func(int *q)
+{
+    int a,b,c,d,e;
+    
+    a = 10;
+    b = 20;
+    c = a + b;
+    d = g + 1;
+    set(&g);
+    e = g + 1;
+    c = a + b;
+    d = *q + 1;
+    set(q);
+    e = g + 1;
+    c = a + b;
+}
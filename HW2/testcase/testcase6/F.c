@@ -0,0 +1,14 @@
+#include <stdio.h>
+
+void func()
+{
+    int a,b,c,d,e;
+    
+    a = 10;
+    b = 20;
+    c = a + b;
+    d = a + b;
+    a = 30;
+    e = a + b;
+    d = a * b;
+}